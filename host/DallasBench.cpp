@@ -0,0 +1,157 @@
+#include "DallasBench.h"
+#include "Dallas.h"
+#include "SimulatedOnewire.h"
+
+static const uint8_t benchFamilies[] = {0x28, 0x10, 0x22, 0x3B, 0x42};
+static const uint8_t benchSizes[] = {1, 2, 4, 8, 16, 32, 64, 128, 255};
+
+/*
+ * the bus traffic of the search step that ends an enumeration: Dallas counts
+ * it, but the OneWire search returns without touching the bus after the last
+ * device
+ */
+#define LAST_SEARCH_RESETS 1
+#define LAST_SEARCH_BITS_WRITTEN (8 + 64)
+#define LAST_SEARCH_BITS_READ 128
+#define LAST_SEARCH_MICROS (960 + (8 + 192) * 70)
+
+static int benchFailures;
+
+static void benchFail(const char *op, uint8_t devices, const char *what,
+                      unsigned long long expected, unsigned long long got) {
+  fprintf(stderr, "bench: %s with %u devices: %s %llu, expected %llu\n", op,
+          devices, what, got, expected);
+  benchFailures++;
+}
+
+/*
+ * checks the bus statistics estimated by Dallas against the traffic the
+ * simulator saw
+ */
+static void benchCheckStats(const char *op, uint8_t devices, Dallas *dallas,
+                            const SimulatedOnewire::Stats &stats,
+                            bool lastSearch) {
+  DallasBusStats total = {};
+  for (uint8_t i = 0; i < DALLAS_OP_COUNT; i++) {
+    DallasBusStats s;
+    if (!dallas->getBusStats(i, &s)) {
+      benchFail(op, devices, "getBusStats op", DALLAS_OP_COUNT, i);
+      return;
+    }
+    total.resets += s.resets;
+    total.bitsWritten += 8 * s.bytesWritten + s.bitsWritten;
+    total.bitsRead += 8 * s.bytesRead + s.bitsRead;
+    total.busMicros += s.busMicros;
+  }
+  if (lastSearch) {
+    total.resets -= LAST_SEARCH_RESETS;
+    total.bitsWritten -= LAST_SEARCH_BITS_WRITTEN;
+    total.bitsRead -= LAST_SEARCH_BITS_READ;
+    total.busMicros -= LAST_SEARCH_MICROS;
+  }
+  if (total.resets != stats.resets) {
+    benchFail(op, devices, "estimated resets", stats.resets, total.resets);
+  }
+  if (total.bitsWritten != stats.bitsWritten) {
+    benchFail(op, devices, "estimated bits written", stats.bitsWritten,
+              total.bitsWritten);
+  }
+  if (total.bitsRead != stats.bitsRead) {
+    benchFail(op, devices, "estimated bits read", stats.bitsRead,
+              total.bitsRead);
+  }
+  if (total.busMicros != stats.busMicros) {
+    benchFail(op, devices, "estimated bus us", stats.busMicros,
+              total.busMicros);
+  }
+}
+
+/*
+ * prints the traffic of op, checks it and starts counting the next one.
+ * resets < 0 skips the check of the reset count.
+ */
+static void benchPrint(FILE *out, const char *op, uint8_t devices,
+                       SimulatedOnewire *sim, Dallas *dallas, int resets,
+                       bool lastSearch = false) {
+  const SimulatedOnewire::Stats &stats = sim->getStats();
+  fprintf(out, "%s,%u,%u,%u,%u,%llu\n", op, devices, stats.resets,
+          stats.bitsWritten, stats.bitsRead,
+          (unsigned long long) stats.busMicros);
+  if (resets >= 0 && stats.resets != (uint32_t) resets) {
+    benchFail(op, devices, "resets", resets, stats.resets);
+  }
+  benchCheckStats(op, devices, dallas, stats, lastSearch);
+  sim->resetStats();
+  dallas->resetBusStats();
+}
+
+static void benchBus(FILE *out, uint8_t devices) {
+  SimulatedOnewire sim(devices);
+  for (int i = 0; i < devices; i++) {
+    sim.addDevice(benchFamilies[i % sizeof(benchFamilies)], 0x1000 + 131 * i,
+                  9 + (7 * i) % 4);
+    sim.setTemperature(i, 128 * (i % 50) - 1000);
+  }
+
+  Dallas dallas;
+  dallas.setOneWire(&sim);
+  // wait the datasheet time, polling would only measure the conversion time
+  dallas.setCheckForConversion(false);
+
+  sim.resetStats();
+  dallas.resetBusStats();
+  dallas.begin();
+  benchPrint(out, "begin", devices, &sim, &dallas, -1, true);
+  if (dallas.getDeviceCount() != devices) {
+    benchFail("begin", devices, "devices found", devices,
+              dallas.getDeviceCount());
+  }
+
+  // one broadcast conversion
+  dallas.requestTemperatures();
+  sim.completeConversions();
+  benchPrint(out, "request_temperatures", devices, &sim, &dallas, 1);
+
+  // the address comes from the ROM cache: no search, whatever the bus size
+  dallas.getTempCByIndex(devices - 1);
+  benchPrint(out, "get_temp_by_index_last", devices, &sim, &dallas, 2);
+
+  for (uint8_t i = 0; i < devices; i++) {
+    dallas.getTempCByIndex(i);
+  }
+  benchPrint(out, "get_temp_by_index_all", devices, &sim, &dallas, -1);
+
+  uint8_t address[8];
+  dallas.getAddress(address, devices - 1);
+  dallas.isConnected(address);
+  benchPrint(out, "is_connected", devices, &sim, &dallas, -1);
+
+  dallas.setResolution(12);
+  benchPrint(out, "set_resolution_global", devices, &sim, &dallas, -1);
+
+  dallas.setResolution(address, 9);
+  benchPrint(out, "set_resolution_device", devices, &sim, &dallas, -1);
+
+  // one conversion, one reset per scratchpad and the reset that ends the
+  // last one
+  int16_t *raw = new int16_t[devices];
+  uint8_t *status = new uint8_t[devices];
+  dallas.readAll(raw, status, devices);
+  benchPrint(out, "read_all", devices, &sim, &dallas, devices + 2);
+  for (uint8_t i = 0; i < devices; i++) {
+    if (status[i] != DEVICE_READ_OK) {
+      benchFail("read_all", devices, "status", DEVICE_READ_OK, status[i]);
+    }
+  }
+  delete[] status;
+  delete[] raw;
+}
+
+int dallasBenchRun(FILE *out) {
+  benchFailures = 0;
+  fprintf(out, "op,devices,resets,bits_written,bits_read,bus_us\n");
+  for (size_t i = 0; i < sizeof(benchSizes); i++) {
+    benchBus(out, benchSizes[i]);
+  }
+  return benchFailures;
+}
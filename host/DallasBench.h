@@ -0,0 +1,16 @@
+#pragma once
+#include <stdio.h>
+
+/*
+ * Runs the public Dallas operations against SimulatedOnewire buses of 1 to 255
+ * devices with mixed families and resolutions and prints the bus traffic of
+ * each operation as CSV lines:
+ * op,devices,resets,bits_written,bits_read,bus_us
+ * The output only depends on Dallas.cpp, so it can be diffed between releases.
+ * Each operation is also checked: the reset counts that must not grow with the
+ * bus (the ROM cache, one conversion per readout) and the bus statistics
+ * estimated by Dallas against the traffic the simulator saw. The failed checks
+ * are printed to stderr.
+ * Returns the number of failed checks.
+ */
+int dallasBenchRun(FILE *out);
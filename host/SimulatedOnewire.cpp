@@ -0,0 +1,604 @@
+#include <string.h>
+#include "SimulatedOnewire.h"
+
+// Model IDs
+#define DS18S20MODEL 0x10  // also DS1820
+#define DS28EA00MODEL 0x42
+
+// ROM commands
+#define SEARCHROM 0xF0
+#define ALARMSEARCH 0xEC
+#define MATCHROM 0x55
+#define SKIPROM 0xCC
+#define OVERDRIVESKIP 0x3C
+#define OVERDRIVEMATCH 0x69
+
+// Function commands
+#define STARTCONVO 0x44
+#define COPYSCRATCH 0x48
+#define READSCRATCH 0xBE
+#define WRITESCRATCH 0x4E
+#define RECALLSCRATCH 0xB8
+#define READPOWERSUPPLY 0xB4
+
+// Scratchpad locations
+#define TEMP_LSB 0
+#define TEMP_MSB 1
+#define HIGH_ALARM_TEMP 2
+#define LOW_ALARM_TEMP 3
+#define CONFIGURATION 4
+#define COUNT_REMAIN 6
+#define COUNT_PER_C 7
+#define SCRATCHPAD_CRC 8
+
+SimulatedOnewire::SimulatedOnewire(uint8_t maxDevices)
+    : _devices(new Device[maxDevices]),
+      _maxDevices(maxDevices),
+      _count(0),
+      _state(STATE_IGNORE),
+      _position(0),
+      _complement(false),
+      _missingPresence(0),
+      _overdrive(false),
+      _micros(0),
+      _clockNow(NULL),
+      _clockAdvance(NULL) {
+  resetStats();
+  reset_search();
+}
+
+SimulatedOnewire::~SimulatedOnewire() {
+  delete[] _devices;
+}
+
+int SimulatedOnewire::addDevice(uint8_t family, uint32_t serial,
+                                uint8_t resolution, bool parasite) {
+  if (_count == _maxDevices) {
+    return -1;
+  }
+  Device *dev = &_devices[_count];
+  memset(dev, 0, sizeof(*dev));
+  dev->rom[0] = family;
+  for (int i = 0; i < 4; i++) {
+    dev->rom[i + 1] = (serial >> (8 * i)) & 0xFF;
+  }
+  dev->rom[7] = crc8(dev->rom, 7);
+
+  // power-on scratchpad: 85 degrees C, TH 75, TL 70
+  resolution = (resolution < 9) ? 9 : (resolution > 12 ? 12 : resolution);
+  dev->scratchPad[HIGH_ALARM_TEMP] = 75;
+  dev->scratchPad[LOW_ALARM_TEMP] = 70;
+  if (family == DS18S20MODEL) {
+    dev->scratchPad[TEMP_LSB] = 0xAA;
+    dev->scratchPad[CONFIGURATION] = 0xFF;
+  } else {
+    dev->scratchPad[TEMP_LSB] = 0x50;
+    dev->scratchPad[TEMP_MSB] = 0x05;
+    dev->scratchPad[CONFIGURATION] = ((resolution - 9) << 5) | 0x1F;
+  }
+  dev->scratchPad[5] = 0xFF;
+  dev->scratchPad[COUNT_REMAIN] = 0x0C;
+  dev->scratchPad[COUNT_PER_C] = 0x10;
+  dev->scratchPad[SCRATCHPAD_CRC] = crc8(dev->scratchPad, 8);
+  memcpy(dev->eeprom, &dev->scratchPad[HIGH_ALARM_TEMP], sizeof(dev->eeprom));
+
+  dev->temperature = 25 * 128;
+  dev->parasite = parasite;
+  dev->connected = true;
+  return _count++;
+}
+
+const uint8_t *SimulatedOnewire::getRom(int index) {
+  Device *dev = device(index);
+  return (dev != NULL) ? dev->rom : NULL;
+}
+
+void SimulatedOnewire::setTemperature(int index, int16_t raw) {
+  Device *dev = device(index);
+  if (dev != NULL) {
+    dev->temperature = raw;
+  }
+}
+
+void SimulatedOnewire::setConnected(int index, bool connected) {
+  Device *dev = device(index);
+  if (dev != NULL) {
+    dev->connected = connected;
+    dev->active = false;
+  }
+}
+
+void SimulatedOnewire::injectCrcErrors(int index, uint16_t count) {
+  Device *dev = device(index);
+  if (dev != NULL) {
+    dev->crcErrors = count;
+  }
+}
+
+void SimulatedOnewire::injectMissingPresence(uint16_t count) {
+  _missingPresence = count;
+}
+
+void SimulatedOnewire::completeConversions(void) {
+  for (uint8_t i = 0; i < _count; i++) {
+    if (_devices[i].converting && _devices[i].conversionEnd > _micros) {
+      tick(_devices[i].conversionEnd - _micros);
+    }
+  }
+}
+
+void SimulatedOnewire::resetStats(void) {
+  memset(&_stats, 0, sizeof(_stats));
+}
+
+/*
+ * a standard speed reset returns all devices to standard speed, only the
+ * devices running at overdrive speed answer an overdrive reset
+ */
+uint8_t SimulatedOnewire::reset(void) {
+  sync();
+  uint32_t micros = _overdrive ? OVERDRIVE_RESET_MICROS : RESET_MICROS;
+  _stats.resets++;
+  _stats.busMicros += micros;
+  tick(micros);
+
+  _state = STATE_ROM;
+  bool presence = false;
+  for (uint8_t i = 0; i < _count; i++) {
+    Device *dev = &_devices[i];
+    dev->active = false;
+    if (!_overdrive) {
+      dev->overdrive = false;
+    }
+    presence = presence || (dev->connected && dev->overdrive == _overdrive);
+  }
+  if (_missingPresence > 0) {
+    _missingPresence--;
+    presence = false;
+  }
+  if (!presence) {
+    _state = STATE_IGNORE;
+  }
+  return presence ? 1 : 0;
+}
+
+void SimulatedOnewire::select(const uint8_t rom[8]) {
+  writeByte(MATCHROM);
+  for (int i = 0; i < 8; i++) {
+    writeByte(rom[i]);
+  }
+}
+
+void SimulatedOnewire::skip(void) {
+  writeByte(SKIPROM);
+}
+
+void SimulatedOnewire::write(uint8_t v, uint8_t power) {
+  (void) power;
+  writeByte(v);
+}
+
+void SimulatedOnewire::write_bytes(const uint8_t *buf, uint16_t count,
+                                   bool power) {
+  (void) power;
+  for (uint16_t i = 0; i < count; i++) {
+    writeByte(buf[i]);
+  }
+}
+
+uint8_t SimulatedOnewire::read(void) {
+  for (int i = 0; i < 8; i++) {
+    slot(true);
+  }
+  if (_state == STATE_READ_SCRATCH && _position < sizeof(_buffer)) {
+    return _buffer[_position++];
+  }
+  return 0xFF;
+}
+
+void SimulatedOnewire::read_bytes(uint8_t *buf, uint16_t count) {
+  for (uint16_t i = 0; i < count; i++) {
+    buf[i] = read();
+  }
+}
+
+void SimulatedOnewire::write_bit(uint8_t v) {
+  slot(false);
+  if (_state != STATE_SEARCH) {
+    return;
+  }
+  // devices whose bit does not match the direction leave the search
+  for (uint8_t i = 0; i < _count; i++) {
+    Device *dev = &_devices[i];
+    if (responds(dev) && romBit(dev, _position) != (v & 1)) {
+      dev->active = false;
+    }
+  }
+  _position++;
+  _complement = false;
+}
+
+uint8_t SimulatedOnewire::read_bit(void) {
+  slot(true);
+  uint8_t b = 1;  // pull-up
+  for (uint8_t i = 0; i < _count; i++) {
+    Device *dev = &_devices[i];
+    if (!responds(dev)) {
+      continue;
+    }
+    switch (_state) {
+      case STATE_SEARCH:
+        b &= romBit(dev, _position) ^ (_complement ? 1 : 0);
+        break;
+      case STATE_READ_POWER:
+        if (dev->parasite) {
+          b = 0;
+        }
+        break;
+      case STATE_CONVERT:
+        update(dev);
+        if (dev->converting) {
+          b = 0;
+        }
+        break;
+      default:
+        break;
+    }
+  }
+  if (_state == STATE_SEARCH) {
+    _complement = !_complement;
+  }
+  return b;
+}
+
+void SimulatedOnewire::depower(void) {
+}
+
+void SimulatedOnewire::reset_search() {
+  _lastDiscrepancy = 0;
+  _lastDeviceFlag = false;
+  _lastFamilyDiscrepancy = 0;
+  memset(_searchRom, 0, sizeof(_searchRom));
+}
+
+void SimulatedOnewire::target_search(uint8_t family_code) {
+  // set the search state to find SearchFamily type devices
+  memset(_searchRom, 0, sizeof(_searchRom));
+  _searchRom[0] = family_code;
+  _lastDiscrepancy = 64;
+  _lastFamilyDiscrepancy = 0;
+  _lastDeviceFlag = false;
+}
+
+/*
+ * The master side of the Maxim ROM search algorithm (application note 187)
+ */
+uint8_t SimulatedOnewire::search(uint8_t *newAddr, bool search_mode) {
+  uint8_t id_bit_number = 1;
+  uint8_t last_zero = 0;
+  uint8_t rom_byte_number = 0;
+  uint8_t rom_byte_mask = 1;
+  bool search_result = false;
+
+  if (!_lastDeviceFlag) {
+    if (!reset()) {
+      reset_search();
+      return 0;
+    }
+
+    writeByte(search_mode ? SEARCHROM : ALARMSEARCH);
+
+    do {
+      uint8_t id_bit = read_bit();
+      uint8_t cmp_id_bit = read_bit();
+      uint8_t search_direction;
+
+      // no devices participating in search
+      if ((id_bit == 1) && (cmp_id_bit == 1)) {
+        break;
+      }
+
+      if (id_bit != cmp_id_bit) {
+        // all devices coupled have 0 or 1
+        search_direction = id_bit;
+      } else {
+        // if this discrepancy is before the Last Discrepancy on a previous
+        // next then pick the same as last time
+        if (id_bit_number < _lastDiscrepancy) {
+          search_direction =
+              ((_searchRom[rom_byte_number] & rom_byte_mask) > 0);
+        } else {
+          // if equal to last pick 1, if not then pick 0
+          search_direction = (id_bit_number == _lastDiscrepancy);
+        }
+        if (search_direction == 0) {
+          last_zero = id_bit_number;
+          if (last_zero < 9) {
+            _lastFamilyDiscrepancy = last_zero;
+          }
+        }
+      }
+
+      if (search_direction == 1) {
+        _searchRom[rom_byte_number] |= rom_byte_mask;
+      } else {
+        _searchRom[rom_byte_number] &= ~rom_byte_mask;
+      }
+      write_bit(search_direction);
+
+      id_bit_number++;
+      rom_byte_mask <<= 1;
+      if (rom_byte_mask == 0) {
+        rom_byte_number++;
+        rom_byte_mask = 1;
+      }
+    } while (rom_byte_number < 8);
+
+    // the search was successful
+    if (id_bit_number == 65) {
+      _lastDiscrepancy = last_zero;
+      if (_lastDiscrepancy == 0) {
+        _lastDeviceFlag = true;
+      }
+      search_result = true;
+    }
+  }
+
+  if (!search_result || !_searchRom[0]) {
+    reset_search();
+    return 0;
+  }
+  memcpy(newAddr, _searchRom, sizeof(_searchRom));
+  return 1;
+}
+
+bool SimulatedOnewire::has_overdrive(void) {
+  return true;
+}
+
+bool SimulatedOnewire::set_overdrive(bool overdrive) {
+  _overdrive = overdrive;
+  return true;
+}
+
+SimulatedOnewire::Device *SimulatedOnewire::device(int index) {
+  return (index >= 0 && index < _count) ? &_devices[index] : NULL;
+}
+
+/*
+ * devices running at another speed than the master do not see the slots
+ */
+bool SimulatedOnewire::responds(const Device *dev) {
+  return dev->active && dev->overdrive == _overdrive;
+}
+
+void SimulatedOnewire::sync(void) {
+  if (_clockNow != NULL) {
+    uint64_t now = _clockNow();
+    if (now > _micros) {
+      _micros = now;
+    }
+  }
+}
+
+void SimulatedOnewire::tick(uint64_t micros) {
+  _micros += micros;
+  if (_clockNow != NULL && _clockAdvance != NULL) {
+    _clockAdvance(micros);
+  }
+}
+
+void SimulatedOnewire::slot(bool isRead) {
+  sync();
+  uint32_t micros = _overdrive ? OVERDRIVE_SLOT_MICROS : SLOT_MICROS;
+  if (isRead) {
+    _stats.bitsRead++;
+  } else {
+    _stats.bitsWritten++;
+  }
+  _stats.busMicros += micros;
+  tick(micros);
+}
+
+void SimulatedOnewire::writeByte(uint8_t v) {
+  for (int i = 0; i < 8; i++) {
+    slot(false);
+  }
+
+  switch (_state) {
+    case STATE_ROM:
+      _position = 0;
+      _complement = false;
+      _state = STATE_FUNCTION;
+      for (uint8_t i = 0; i < _count; i++) {
+        Device *dev = &_devices[i];
+        bool present = dev->connected && dev->overdrive == _overdrive;
+        switch (v) {
+          case SKIPROM:
+          case SEARCHROM:
+            dev->active = present;
+            break;
+          case ALARMSEARCH:
+            dev->active = present && alarm(dev);
+            break;
+          case OVERDRIVESKIP:
+          case OVERDRIVEMATCH:
+            // overdrive capable devices switch to overdrive speed
+            if (present && dev->rom[0] == DS28EA00MODEL) {
+              dev->overdrive = true;
+              dev->active = (v == OVERDRIVESKIP);
+            } else {
+              dev->active = false;
+            }
+            break;
+          default:
+            dev->active = false;
+        }
+      }
+      if (v == MATCHROM || v == OVERDRIVEMATCH) {
+        _state = STATE_MATCH;
+      } else if (v == SEARCHROM || v == ALARMSEARCH) {
+        _state = STATE_SEARCH;
+      } else if (v != SKIPROM && v != OVERDRIVESKIP) {
+        _state = STATE_IGNORE;
+      }
+      break;
+
+    case STATE_MATCH:
+      _buffer[_position++] = v;
+      if (_position == 8) {
+        for (uint8_t i = 0; i < _count; i++) {
+          Device *dev = &_devices[i];
+          dev->active = dev->connected && dev->overdrive == _overdrive &&
+                        memcmp(dev->rom, _buffer, 8) == 0;
+        }
+        _state = STATE_FUNCTION;
+      }
+      break;
+
+    case STATE_FUNCTION:
+      command(v);
+      break;
+
+    case STATE_WRITE_SCRATCH:
+      for (uint8_t i = 0; i < _count; i++) {
+        Device *dev = &_devices[i];
+        if (!responds(dev)) {
+          continue;
+        }
+        if (_position < 2) {
+          dev->scratchPad[HIGH_ALARM_TEMP + _position] = v;
+        } else if (_position == 2 && dev->rom[0] != DS18S20MODEL) {
+          dev->scratchPad[CONFIGURATION] = (v & 0x60) | 0x1F;
+        }
+        dev->scratchPad[SCRATCHPAD_CRC] = crc8(dev->scratchPad, 8);
+      }
+      _position++;
+      break;
+
+    default:
+      break;
+  }
+}
+
+void SimulatedOnewire::command(uint8_t v) {
+  _position = 0;
+  switch (v) {
+    case STARTCONVO:
+      _state = STATE_CONVERT;
+      break;
+    case READSCRATCH:
+      _state = STATE_READ_SCRATCH;
+      memset(_buffer, 0xFF, sizeof(_buffer));
+      break;
+    case WRITESCRATCH:
+      _state = STATE_WRITE_SCRATCH;
+      break;
+    case READPOWERSUPPLY:
+      _state = STATE_READ_POWER;
+      break;
+    default:
+      _state = STATE_IGNORE;
+      break;
+  }
+
+  for (uint8_t i = 0; i < _count; i++) {
+    Device *dev = &_devices[i];
+    if (!responds(dev)) {
+      continue;
+    }
+    update(dev);
+    switch (v) {
+      case STARTCONVO: {
+        uint8_t resolution =
+            (dev->rom[0] == DS18S20MODEL)
+                ? 12
+                : ((dev->scratchPad[CONFIGURATION] >> 5) & 0x03) + 9;
+        dev->converting = true;
+        dev->conversionEnd = _micros + (750000 >> (12 - resolution));
+        break;
+      }
+      case READSCRATCH:
+        // several devices answering at once give the wired-AND of their data
+        for (int j = 0; j < 9; j++) {
+          uint8_t b = dev->scratchPad[j];
+          if (j == SCRATCHPAD_CRC && dev->crcErrors > 0) {
+            b ^= 0x01;
+          }
+          _buffer[j] &= b;
+        }
+        if (dev->crcErrors > 0) {
+          dev->crcErrors--;
+        }
+        break;
+      case COPYSCRATCH:
+        memcpy(dev->eeprom, &dev->scratchPad[HIGH_ALARM_TEMP],
+               sizeof(dev->eeprom));
+        break;
+      case RECALLSCRATCH:
+        memcpy(&dev->scratchPad[HIGH_ALARM_TEMP], dev->eeprom,
+               sizeof(dev->eeprom));
+        dev->scratchPad[SCRATCHPAD_CRC] = crc8(dev->scratchPad, 8);
+        break;
+    }
+  }
+}
+
+/*
+ * stores the measured temperature in the scratchpad when a pending conversion
+ * is complete
+ */
+void SimulatedOnewire::update(Device *dev) {
+  if (!dev->converting || _micros < dev->conversionEnd) {
+    return;
+  }
+  dev->converting = false;
+
+  int16_t reg;
+  if (dev->rom[0] == DS18S20MODEL) {
+    // 0.5 degrees C register, extended resolution through COUNT_REMAIN
+    reg = dev->temperature >> 6;
+    int16_t remain = 16 - (dev->temperature - (reg >> 1) * 128 + 32) / 8;
+    dev->scratchPad[COUNT_REMAIN] =
+        (remain < 0) ? 0 : (remain > 16 ? 16 : remain);
+  } else {
+    // 1/16 degrees C register, undefined bits cleared
+    uint8_t resolution = ((dev->scratchPad[CONFIGURATION] >> 5) & 0x03) + 9;
+    reg = (dev->temperature >> 3) & ~((1 << (12 - resolution)) - 1);
+  }
+  dev->scratchPad[TEMP_LSB] = reg & 0xFF;
+  dev->scratchPad[TEMP_MSB] = (reg >> 8) & 0xFF;
+  dev->scratchPad[SCRATCHPAD_CRC] = crc8(dev->scratchPad, 8);
+}
+
+/*
+ * alarm condition: T >= TH or T <= TL, compared in whole degrees
+ */
+bool SimulatedOnewire::alarm(Device *dev) {
+  update(dev);
+  int16_t reg = (int16_t)((dev->scratchPad[TEMP_MSB] << 8) |
+                          dev->scratchPad[TEMP_LSB]);
+  int16_t t = (dev->rom[0] == DS18S20MODEL) ? (reg >> 1) : (reg >> 4);
+  return t >= (int8_t) dev->scratchPad[HIGH_ALARM_TEMP] ||
+         t <= (int8_t) dev->scratchPad[LOW_ALARM_TEMP];
+}
+
+uint8_t SimulatedOnewire::romBit(const Device *dev, uint8_t position) {
+  return (dev->rom[position / 8] >> (position % 8)) & 1;
+}
+
+uint8_t SimulatedOnewire::crc8(const uint8_t *addr, uint8_t len) {
+  uint8_t crc = 0;
+  while (len-- > 0) {
+    uint8_t inbyte = *addr++;
+    for (int i = 8; i > 0; i--) {
+      uint8_t mix = (crc ^ inbyte) & 0x01;
+      crc >>= 1;
+      if (mix) {
+        crc ^= 0x8C;
+      }
+      inbyte >>= 1;
+    }
+  }
+  return crc;
+}
@@ -0,0 +1,195 @@
+#pragma once
+#include <stdint.h>
+#include "OnewireInterface.h"
+
+/*
+ * Software model of a 1-Wire bus populated with temperature sensors of the
+ * families supported by Dallas. It answers the ROM commands (search, alarm
+ * search, match, skip, overdrive match and skip) and the scratchpad,
+ * conversion and power supply function commands, so Dallas can run without
+ * hardware in the host bench and tests. It is not part of the firmware build.
+ * DS28EA00 devices support overdrive speed.
+ *
+ * The bus time is accounted in microseconds using standard or overdrive speed
+ * slot timings.
+ * The simulated clock advances with bus traffic, advanceMicros() and, if set,
+ * an external clock, see setClock().
+ */
+class SimulatedOnewire : public OnewireInterface {
+ public:
+  /*
+   * Standard and overdrive speed timings in microseconds
+   */
+  static const uint32_t RESET_MICROS = 960;  // reset pulse + presence detect
+  static const uint32_t SLOT_MICROS = 70;    // one read or write time slot
+  static const uint32_t OVERDRIVE_RESET_MICROS = 146;
+  static const uint32_t OVERDRIVE_SLOT_MICROS = 10;
+
+  /*
+   * Bus traffic counters
+   */
+  typedef struct {
+    uint32_t resets;
+    uint32_t bitsWritten;
+    uint32_t bitsRead;
+    uint64_t busMicros;
+  } Stats;
+
+  SimulatedOnewire(uint8_t maxDevices);
+  virtual ~SimulatedOnewire();
+
+  /*
+   * Adds a device of family (0x10, 0x28, 0x22, 0x3B or 0x42) with the given
+   * serial number, resolution (ignored for 0x10) and power mode.
+   * Returns the index of the new device or -1 if the bus is full.
+   */
+  int addDevice(uint8_t family, uint32_t serial, uint8_t resolution = 12,
+                bool parasite = false);
+
+  uint8_t getDeviceCount(void) {
+    return _count;
+  }
+
+  /*
+   * Returns the ROM of the device at index or NULL
+   */
+  const uint8_t *getRom(int index);
+
+  /*
+   * Sets the temperature (in 1/128 degrees C) the device measures on the next
+   * conversion
+   */
+  void setTemperature(int index, int16_t raw);
+
+  /*
+   * Connects/disconnects a device from the bus
+   */
+  void setConnected(int index, bool connected);
+
+  /*
+   * Corrupts the next count scratchpad reads of the device
+   */
+  void injectCrcErrors(int index, uint16_t count);
+
+  /*
+   * The next count resets are not answered by a presence pulse
+   */
+  void injectMissingPresence(uint16_t count);
+
+  /*
+   * Advances the simulated clock, e.g. to let conversions complete
+   */
+  void advanceMicros(uint32_t micros) {
+    tick(micros);
+  }
+
+  /*
+   * Advances the simulated clock until every pending conversion is complete
+   */
+  void completeConversions(void);
+
+  /*
+   * Shares the simulated clock with the caller: before each reset and time
+   * slot it is advanced to the time returned by now (in microseconds), and
+   * advance (may be NULL) is called with the time the bus spends. With the
+   * mgos stub clock the conversions progress while Dallas waits on timers.
+   * A NULL now detaches the clock.
+   */
+  void setClock(uint64_t (*now)(void), void (*advance)(uint64_t micros)) {
+    _clockNow = now;
+    _clockAdvance = advance;
+  }
+
+  uint64_t getMicros(void) {
+    return _micros;
+  }
+
+  const Stats &getStats(void) {
+    return _stats;
+  }
+
+  void resetStats(void);
+
+  /*
+   * OnewireInterface
+   */
+  virtual uint8_t reset(void);
+  virtual void select(const uint8_t rom[8]);
+  virtual void skip(void);
+  virtual void write(uint8_t v, uint8_t power = 0);
+  virtual void write_bytes(const uint8_t *buf, uint16_t count,
+                           bool power = 0);
+  virtual uint8_t read(void);
+  virtual void read_bytes(uint8_t *buf, uint16_t count);
+  virtual void write_bit(uint8_t v);
+  virtual uint8_t read_bit(void);
+  virtual void depower(void);
+  virtual void reset_search();
+  virtual void target_search(uint8_t family_code);
+  virtual uint8_t search(uint8_t *newAddr, bool search_mode = true);
+  virtual bool has_overdrive(void);
+  virtual bool set_overdrive(bool overdrive);
+
+ protected:
+  typedef struct {
+    uint8_t rom[8];
+    uint8_t scratchPad[9];
+    uint8_t eeprom[3];  // TH, TL, configuration
+    int16_t temperature;
+    uint64_t conversionEnd;
+    bool converting;
+    bool parasite;
+    bool connected;
+    bool active;     // selected or still participating in a search
+    bool overdrive;  // running at overdrive speed
+    uint16_t crcErrors;
+  } Device;
+
+  enum State {
+    STATE_ROM,          // waiting for a ROM command
+    STATE_MATCH,        // receiving the ROM of a match command
+    STATE_FUNCTION,     // waiting for a function command
+    STATE_SEARCH,       // inside a (alarm) search
+    STATE_READ_SCRATCH, // reading the scratchpad
+    STATE_WRITE_SCRATCH,
+    STATE_READ_POWER,
+    STATE_CONVERT,
+    STATE_IGNORE,
+  };
+
+  Device *_devices;
+  uint8_t _maxDevices;
+  uint8_t _count;
+
+  State _state;
+  uint8_t _position;
+  bool _complement;
+  uint8_t _buffer[9];
+  uint16_t _missingPresence;
+  bool _overdrive;
+
+  uint64_t _micros;
+  uint64_t (*_clockNow)(void);
+  void (*_clockAdvance)(uint64_t micros);
+  Stats _stats;
+
+  /*
+   * Master side search state
+   */
+  uint8_t _searchRom[8];
+  uint8_t _lastDiscrepancy;
+  uint8_t _lastFamilyDiscrepancy;
+  bool _lastDeviceFlag;
+
+  Device *device(int index);
+  bool responds(const Device *dev);
+  void sync(void);
+  void tick(uint64_t micros);
+  void slot(bool isRead);
+  void writeByte(uint8_t v);
+  void command(uint8_t v);
+  void update(Device *dev);
+  bool alarm(Device *dev);
+  static uint8_t romBit(const Device *dev, uint8_t position);
+  static uint8_t crc8(const uint8_t *addr, uint8_t len);
+};
@@ -0,0 +1,22 @@
+#include <stdio.h>
+#include "DallasBench.h"
+
+/*
+ * Writes the bench CSV to the file given as argument or to stdout, fails if a
+ * check of the bench failed
+ */
+int main(int argc, char **argv) {
+  FILE *out = stdout;
+  if (argc > 1) {
+    out = fopen(argv[1], "w");
+    if (out == NULL) {
+      perror(argv[1]);
+      return 1;
+    }
+  }
+  int failures = dallasBenchRun(out);
+  if (out != stdout) {
+    fclose(out);
+  }
+  return failures != 0 ? 1 : 0;
+}
@@ -0,0 +1,176 @@
+#include <freertos/queue.h>
+#include <freertos/task.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <vector>
+
+struct HostQueue {
+  std::mutex lock;
+  std::condition_variable changed;
+  std::deque<std::vector<uint8_t> > items;
+  UBaseType_t length;
+  UBaseType_t itemSize;
+};
+
+struct HostTask {
+  std::mutex lock;
+  std::condition_variable notified;
+  uint32_t notifications;
+  TaskFunction_t fn;
+  void *arg;
+};
+
+/*
+ * threads not created by xTaskCreate() get a task on first use
+ */
+static thread_local HostTask *s_current = NULL;
+
+static const std::chrono::steady_clock::time_point s_boot =
+    std::chrono::steady_clock::now();
+
+/*
+ * waits on cv until ready() or the ticks have passed
+ */
+template <typename Ready>
+static bool waitFor(std::condition_variable &cv,
+                    std::unique_lock<std::mutex> &lock, TickType_t ticks,
+                    Ready ready) {
+  if (ticks == portMAX_DELAY) {
+    cv.wait(lock, ready);
+    return true;
+  }
+  return cv.wait_for(lock, std::chrono::milliseconds(ticks), ready);
+}
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t itemSize) {
+  HostQueue *queue = new HostQueue;
+  queue->length = length;
+  queue->itemSize = itemSize;
+  return queue;
+}
+
+void vQueueDelete(QueueHandle_t queue) {
+  delete queue;
+}
+
+BaseType_t xQueueSend(QueueHandle_t queue, const void *item,
+                      TickType_t ticksToWait) {
+  std::unique_lock<std::mutex> lock(queue->lock);
+  if (!waitFor(queue->changed, lock, ticksToWait,
+               [queue] { return queue->items.size() < queue->length; })) {
+    return pdFALSE;
+  }
+  const uint8_t *bytes = (const uint8_t *) item;
+  queue->items.push_back(
+      std::vector<uint8_t>(bytes, bytes + queue->itemSize));
+  queue->changed.notify_all();
+  return pdTRUE;
+}
+
+static BaseType_t queueGet(QueueHandle_t queue, void *item,
+                           TickType_t ticksToWait, bool remove) {
+  std::unique_lock<std::mutex> lock(queue->lock);
+  if (!waitFor(queue->changed, lock, ticksToWait,
+               [queue] { return !queue->items.empty(); })) {
+    return pdFALSE;
+  }
+  memcpy(item, queue->items.front().data(), queue->itemSize);
+  if (remove) {
+    queue->items.pop_front();
+    queue->changed.notify_all();
+  }
+  return pdTRUE;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t queue, void *item,
+                         TickType_t ticksToWait) {
+  return queueGet(queue, item, ticksToWait, true);
+}
+
+BaseType_t xQueuePeek(QueueHandle_t queue, void *item,
+                      TickType_t ticksToWait) {
+  return queueGet(queue, item, ticksToWait, false);
+}
+
+static void *taskMain(void *arg) {
+  s_current = (HostTask *) arg;
+  s_current->fn(s_current->arg);
+  return NULL;
+}
+
+BaseType_t xTaskCreate(TaskFunction_t fn, const char *name,
+                       uint32_t stackDepth, void *arg, UBaseType_t priority,
+                       TaskHandle_t *created) {
+  (void) name;
+  (void) stackDepth;
+  (void) priority;
+  HostTask *task = new HostTask;
+  task->notifications = 0;
+  task->fn = fn;
+  task->arg = arg;
+  pthread_t thread;
+  if (pthread_create(&thread, NULL, taskMain, task) != 0) {
+    delete task;
+    return pdFALSE;
+  }
+  pthread_detach(thread);
+  if (created != NULL) {
+    *created = task;
+  }
+  return pdPASS;
+}
+
+void vTaskDelete(TaskHandle_t task) {
+  if (task != NULL && task != s_current) {
+    abort();
+  }
+  delete s_current;
+  s_current = NULL;
+  pthread_exit(NULL);
+}
+
+TickType_t xTaskGetTickCount(void) {
+  return (TickType_t) std::chrono::duration_cast<std::chrono::milliseconds>(
+             std::chrono::steady_clock::now() - s_boot)
+      .count();
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void) {
+  if (s_current == NULL) {
+    s_current = new HostTask;
+    s_current->notifications = 0;
+    s_current->fn = NULL;
+    s_current->arg = NULL;
+  }
+  return s_current;
+}
+
+void vTaskDelay(TickType_t ticks) {
+  struct timespec ts = {(time_t)(ticks / 1000),
+                        (long) (ticks % 1000) * 1000000};
+  nanosleep(&ts, NULL);
+}
+
+void xTaskNotifyGive(TaskHandle_t task) {
+  std::lock_guard<std::mutex> lock(task->lock);
+  task->notifications++;
+  task->notified.notify_all();
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clearOnExit, TickType_t ticksToWait) {
+  HostTask *task = xTaskGetCurrentTaskHandle();
+  std::unique_lock<std::mutex> lock(task->lock);
+  if (!waitFor(task->notified, lock, ticksToWait,
+               [task] { return task->notifications > 0; })) {
+    return 0;
+  }
+  uint32_t value = task->notifications;
+  task->notifications = clearOnExit ? 0 : value - 1;
+  return value;
+}
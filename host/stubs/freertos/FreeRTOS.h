@@ -0,0 +1,20 @@
+#pragma once
+#include <stdint.h>
+
+/*
+ * The part of the FreeRTOS API used by DallasBusWorker, on POSIX threads.
+ * One tick is one millisecond.
+ */
+
+typedef uint32_t TickType_t;
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+
+typedef struct HostTask *TaskHandle_t;
+typedef struct HostQueue *QueueHandle_t;
+
+#define pdFALSE 0
+#define pdTRUE 1
+#define pdPASS pdTRUE
+#define portMAX_DELAY ((TickType_t) 0xFFFFFFFF)
+#define pdMS_TO_TICKS(ms) ((TickType_t)(ms))
@@ -0,0 +1,22 @@
+#pragma once
+#include "FreeRTOS.h"
+
+typedef void (*TaskFunction_t)(void *arg);
+
+/*
+ * stackDepth and priority are ignored
+ */
+BaseType_t xTaskCreate(TaskFunction_t fn, const char *name,
+                       uint32_t stackDepth, void *arg, UBaseType_t priority,
+                       TaskHandle_t *created);
+
+/*
+ * Only a task deleting itself (task NULL) is supported
+ */
+void vTaskDelete(TaskHandle_t task);
+
+TickType_t xTaskGetTickCount(void);
+TaskHandle_t xTaskGetCurrentTaskHandle(void);
+void vTaskDelay(TickType_t ticks);
+void xTaskNotifyGive(TaskHandle_t task);
+uint32_t ulTaskNotifyTake(BaseType_t clearOnExit, TickType_t ticksToWait);
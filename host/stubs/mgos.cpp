@@ -0,0 +1,98 @@
+#include <mgos.h>
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include "mgos_stub.h"
+
+typedef struct {
+  mgos_timer_id id;
+  uint64_t due;
+  timer_callback cb;
+  void *arg;
+} Timer;
+
+static std::atomic<uint64_t> s_micros(0);
+static std::mutex s_lock;
+static std::vector<Timer> s_timers;
+static mgos_timer_id s_nextId = 1;
+
+uint64_t mgos_stub_micros(void) {
+  return s_micros;
+}
+
+void mgos_stub_advance(uint64_t usecs) {
+  s_micros += usecs;
+}
+
+/*
+ * timers due at the same time run in the order they were set
+ */
+bool mgos_stub_run_next_timer(void) {
+  Timer timer;
+  {
+    std::lock_guard<std::mutex> lock(s_lock);
+    if (s_timers.empty()) {
+      return false;
+    }
+    size_t next = 0;
+    for (size_t i = 1; i < s_timers.size(); i++) {
+      if (s_timers[i].due < s_timers[next].due) {
+        next = i;
+      }
+    }
+    timer = s_timers[next];
+    s_timers.erase(s_timers.begin() + next);
+  }
+  if (timer.due > s_micros) {
+    s_micros = timer.due;
+  }
+  timer.cb(timer.arg);
+  return true;
+}
+
+int mgos_stub_run_timers(void) {
+  int count = 0;
+  while (mgos_stub_run_next_timer()) {
+    count++;
+  }
+  return count;
+}
+
+extern "C" {
+
+double mgos_uptime(void) {
+  return s_micros / 1e6;
+}
+
+void mgos_usleep(uint32_t usecs) {
+  s_micros += usecs;
+}
+
+/*
+ * repeating timers are not supported, the library does not use them
+ */
+mgos_timer_id mgos_set_timer(int msecs, int flags, timer_callback cb,
+                             void *cb_arg) {
+  (void) flags;
+  std::lock_guard<std::mutex> lock(s_lock);
+  Timer timer = {s_nextId++, s_micros + 1000 * (uint64_t) msecs, cb, cb_arg};
+  s_timers.push_back(timer);
+  return timer.id;
+}
+
+void mgos_clear_timer(mgos_timer_id id) {
+  std::lock_guard<std::mutex> lock(s_lock);
+  for (size_t i = 0; i < s_timers.size(); i++) {
+    if (s_timers[i].id == id) {
+      s_timers.erase(s_timers.begin() + i);
+      return;
+    }
+  }
+}
+
+bool mgos_invoke_cb(mgos_cb_t cb, void *arg, bool from_isr) {
+  (void) from_isr;
+  cb(arg);
+  return true;
+}
+}
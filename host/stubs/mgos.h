@@ -0,0 +1,59 @@
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * The part of the Mongoose OS API used by the library, enough to build and
+ * run it on a host. The uptime is a virtual clock: it only advances with
+ * mgos_usleep() and when a timer is run, see mgos_stub.h
+ */
+
+#ifndef MIN
+#define MIN(a, b) ((a) < (b) ? (a) : (b))
+#endif
+#ifndef MAX
+#define MAX(a, b) ((a) > (b) ? (a) : (b))
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+double mgos_uptime(void);
+void mgos_usleep(uint32_t usecs);
+
+typedef uintptr_t mgos_timer_id;
+typedef void (*timer_callback)(void *param);
+
+#define MGOS_INVALID_TIMER_ID 0
+#define MGOS_TIMER_REPEAT 1
+
+mgos_timer_id mgos_set_timer(int msecs, int flags, timer_callback cb,
+                             void *cb_arg);
+void mgos_clear_timer(mgos_timer_id id);
+
+typedef void (*mgos_cb_t)(void *arg);
+bool mgos_invoke_cb(mgos_cb_t cb, void *arg, bool from_isr);
+
+enum cs_log_level {
+  LL_NONE = -1,
+  LL_ERROR = 0,
+  LL_WARN = 1,
+  LL_INFO = 2,
+  LL_DEBUG = 3,
+  LL_VERBOSE_DEBUG = 4,
+};
+
+#define LOG(l, x)     \
+  do {                \
+    (void) (l);       \
+    printf x;         \
+    printf("\n");     \
+  } while (0)
+
+#ifdef __cplusplus
+}
+#endif
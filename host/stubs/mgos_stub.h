@@ -0,0 +1,28 @@
+#pragma once
+#include <stdint.h>
+
+/*
+ * Control of the virtual clock behind the mgos.h stub
+ */
+
+/*
+ * Returns the uptime in microseconds
+ */
+uint64_t mgos_stub_micros(void);
+
+/*
+ * Advances the uptime by usecs
+ */
+void mgos_stub_advance(uint64_t usecs);
+
+/*
+ * Advances the uptime to the earliest timer and runs it.
+ * Returns false if no timer is set.
+ */
+bool mgos_stub_run_next_timer(void);
+
+/*
+ * Runs the timers until none is left, including the ones they set.
+ * Returns the number of timers run.
+ */
+int mgos_stub_run_timers(void);
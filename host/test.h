@@ -0,0 +1,19 @@
+#pragma once
+#include <stdio.h>
+
+/*
+ * Minimal checks for the host tests: a failed CHECK is printed and makes
+ * TEST_RESULT() nonzero, which main() returns to ctest
+ */
+static int testFailures = 0;
+
+#define CHECK(cond)                                                 \
+  do {                                                              \
+    if (!(cond)) {                                                  \
+      fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, \
+              #cond);                                               \
+      testFailures++;                                               \
+    }                                                               \
+  } while (0)
+
+#define TEST_RESULT() (testFailures != 0 ? 1 : 0)
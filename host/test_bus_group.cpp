@@ -0,0 +1,118 @@
+#include <mgos.h>
+#include "DallasBusGroup.h"
+#include "SimulatedOnewire.h"
+#include "mgos_stub.h"
+#include "test.h"
+
+/*
+ * Blocking and timer driven reads of a group of two buses, started within
+ * the first conversion time after boot (uptime 0)
+ */
+
+#define BUSES 2
+#define DEVICES 3
+#define POWER_ON_RAW (85 * 128)
+
+typedef struct {
+  SimulatedOnewire *sim[BUSES];
+  Dallas dallas[BUSES];
+  DallasBusGroup group;
+} Bench;
+
+static void setup(Bench *bench, bool checkForConversion) {
+  for (int b = 0; b < BUSES; b++) {
+    SimulatedOnewire *sim = new SimulatedOnewire(DEVICES);
+    sim->setClock(mgos_stub_micros, mgos_stub_advance);
+    for (int j = 0; j < DEVICES; j++) {
+      sim->addDevice(0x28, 0x200 + 16 * b + j, 12);
+    }
+    bench->sim[b] = sim;
+    bench->dallas[b].setOneWire(sim);
+    bench->dallas[b].setCheckForConversion(checkForConversion);
+    bench->dallas[b].begin();
+    bench->group.addBus(&bench->dallas[b]);
+  }
+}
+
+static void teardown(Bench *bench) {
+  for (int b = 0; b < BUSES; b++) {
+    delete bench->sim[b];
+  }
+}
+
+static void setTemperatures(Bench *bench, int16_t base) {
+  for (int b = 0; b < BUSES; b++) {
+    for (int j = 0; j < DEVICES; j++) {
+      bench->sim[b]->setTemperature(j, 128 * (base + 10 * b + j));
+    }
+  }
+}
+
+/*
+ * every device read with the temperature of the current conversion
+ */
+static void checkResults(Bench *bench, const int16_t *raw,
+                         const uint8_t *status, int16_t base) {
+  for (int b = 0; b < BUSES; b++) {
+    for (uint8_t i = 0; i < DEVICES; i++) {
+      uint8_t address[8];
+      bench->dallas[b].getAddress(address, i);
+      int j = address[1] - 16 * b;  // serial 0x200 + 16 * b + j
+      int k = b * DEVICES + i;
+      CHECK(status[k] == DEVICE_READ_OK);
+      CHECK(raw[k] != POWER_ON_RAW);
+      CHECK(raw[k] == 128 * (base + 10 * b + j));
+    }
+  }
+}
+
+static void testReadAll(bool checkForConversion) {
+  Bench bench;
+  setup(&bench, checkForConversion);
+
+  int16_t raw[BUSES * DEVICES];
+  uint8_t status[BUSES * DEVICES];
+  setTemperatures(&bench, 20);
+  uint64_t start = mgos_stub_micros();
+  CHECK(bench.group.readAll(raw, status, BUSES * DEVICES) ==
+        BUSES * DEVICES);
+  CHECK(mgos_stub_micros() - start >= 750000);
+  checkResults(&bench, raw, status, 20);
+
+  setTemperatures(&bench, -5);
+  CHECK(bench.group.readAll(raw, status, BUSES * DEVICES) ==
+        BUSES * DEVICES);
+  checkResults(&bench, raw, status, -5);
+  teardown(&bench);
+}
+
+static void readCb(DallasBusGroup *group, void *arg) {
+  (void) group;
+  (*(int *) arg)++;
+}
+
+static void testReadAllAsync(bool checkForConversion) {
+  Bench bench;
+  setup(&bench, checkForConversion);
+
+  int16_t raw[BUSES * DEVICES];
+  uint8_t status[BUSES * DEVICES];
+  int calls = 0;
+  setTemperatures(&bench, 30);
+  CHECK(bench.group.readAllAsync(raw, status, BUSES * DEVICES, readCb,
+                                 &calls));
+  CHECK(bench.group.isReadPending());
+  mgos_stub_run_timers();
+  CHECK(calls == 1);
+  checkResults(&bench, raw, status, 30);
+  teardown(&bench);
+}
+
+int main(void) {
+  // first, while the uptime is below the conversion time
+  testReadAll(true);
+  testReadAll(false);
+  testReadAllAsync(true);
+  testReadAllAsync(false);
+  return TEST_RESULT();
+}
@@ -0,0 +1,121 @@
+#include <mgos.h>
+#include <string.h>
+#include "Dallas.h"
+#include "SimulatedOnewire.h"
+#include "mgos_stub.h"
+#include "test.h"
+
+/*
+ * setChangeReporting(): the first value of every device is reported, then
+ * only the values moving more than the deadband away from the last reported
+ * one, or any value after maxSilence. Failed reads are never reported.
+ */
+
+#define DEVICES 2
+#define DEADBAND 64  // 0.5 C
+#define MAX_SILENCE 60000
+#define BASE (128 * 20)
+
+static SimulatedOnewire sim(DEVICES);
+static Dallas dallas;
+static int simIndex[DEVICES];
+
+static struct {
+  uint8_t dallasIndex;
+  int16_t raw;
+} reports[8];
+static int reportCount;
+
+static void changeCb(Dallas *d, const uint8_t *deviceAddress, int16_t raw,
+                     void *arg) {
+  CHECK(d == &dallas);
+  CHECK(arg == &reportCount);
+  if (reportCount < 8) {
+    uint8_t i = 0;
+    while (i < DEVICES &&
+           memcmp(dallas.getDeviceInfo(i)->address, deviceAddress, 8) != 0) {
+      i++;
+    }
+    CHECK(i < DEVICES);
+    reports[reportCount].dallasIndex = i;
+    reports[reportCount].raw = raw;
+  }
+  reportCount++;
+}
+
+/*
+ * converts the temperatures given by Dallas index, reads them all and returns
+ * the number of reports
+ */
+static int readAll(int16_t raw0, int16_t raw1) {
+  sim.setTemperature(simIndex[0], raw0);
+  sim.setTemperature(simIndex[1], raw1);
+  reportCount = 0;
+  int16_t raw[DEVICES];
+  dallas.readAll(raw, NULL, DEVICES);
+  return reportCount;
+}
+
+int main(void) {
+  sim.setClock(mgos_stub_micros, mgos_stub_advance);
+  sim.addDevice(0x28, 0xB01);
+  sim.addDevice(0x28, 0xB02);
+  dallas.setOneWire(&sim);
+  dallas.begin();
+  CHECK(dallas.getDeviceCount() == DEVICES);
+  for (uint8_t i = 0; i < DEVICES; i++) {
+    simIndex[i] = dallas.getDeviceInfo(i)->address[1] - 1;  // serial 0xB01 + j
+  }
+  dallas.setChangeReporting(DEADBAND, MAX_SILENCE, changeCb, &reportCount);
+
+  // the first values
+  CHECK(readAll(BASE, BASE) == 2);
+  CHECK(reports[0].raw == BASE && reports[1].raw == BASE);
+  CHECK(reports[0].dallasIndex != reports[1].dallasIndex);
+
+  // within the deadband, boundary included
+  CHECK(readAll(BASE + DEADBAND, BASE - DEADBAND) == 0);
+
+  // just out of it (12 bits: steps of 8)
+  CHECK(readAll(BASE + DEADBAND + 8, BASE) == 1);
+  CHECK(reports[0].dallasIndex == 0 && reports[0].raw == BASE + DEADBAND + 8);
+  CHECK(readAll(BASE + DEADBAND + 8, BASE - DEADBAND - 8) == 1);
+  CHECK(reports[0].dallasIndex == 1 && reports[0].raw == BASE - DEADBAND - 8);
+
+  // a slow drift is measured from the last report, not the last read
+  int16_t last = BASE + DEADBAND + 8;
+  CHECK(readAll(last + 40, BASE - DEADBAND - 8) == 0);
+  CHECK(readAll(last + 80, BASE - DEADBAND - 8) == 1);
+  CHECK(reports[0].raw == last + 80);
+  last += 80;
+
+  // failed reads are not reported
+  sim.setConnected(simIndex[1], false);
+  CHECK(readAll(last, BASE + 128 * 10) == 0);
+  sim.setConnected(simIndex[1], true);
+
+  // silent for too long: reported again
+  mgos_stub_advance((uint64_t) MAX_SILENCE * 1000);
+  CHECK(readAll(last, BASE - DEADBAND - 8) == 2);
+  CHECK(readAll(last, BASE - DEADBAND - 8) == 0);
+
+  // getTemp() reports as well
+  uint8_t address[8];
+  dallas.getAddress(address, 0);
+  sim.setTemperature(simIndex[0], BASE);
+  dallas.requestTemperatures();
+  reportCount = 0;
+  CHECK(dallas.getTemp(address) == BASE);
+  CHECK(reportCount == 1 && reports[0].dallasIndex == 0);
+
+  // set again: the first values are reported again, no silence limit
+  dallas.setChangeReporting(DEADBAND, 0, changeCb, &reportCount);
+  CHECK(readAll(BASE, BASE) == 2);
+  mgos_stub_advance((uint64_t) 10 * MAX_SILENCE * 1000);
+  CHECK(readAll(BASE, BASE) == 0);
+
+  // stopped
+  dallas.setChangeReporting(DEADBAND, 0, NULL, NULL);
+  CHECK(readAll(BASE + 128 * 5, BASE - 128 * 5) == 0);
+  return TEST_RESULT();
+}
@@ -0,0 +1,98 @@
+#include <math.h>
+#include <mgos.h>
+#include "Dallas.h"
+#include "SimulatedOnewire.h"
+#include "mgos_dallas_interface.h"
+#include "mgos_stub.h"
+#include "test.h"
+
+/*
+ * The integer raw conversions against the float ones for every raw value from
+ * DEVICE_DISCONNECTED_RAW up: C and milli C are exact in double precision and
+ * must match round(), F must be within half a unit of the float result. Then
+ * the C API returning them.
+ */
+
+#define FLOAT_F_ERROR 0.01  // float rounding of rawToFahrenheit() * 100
+
+static void testAllRaw(void) {
+  int failures = 0;
+  for (int32_t r = DEVICE_DISCONNECTED_RAW + 1; r <= INT16_MAX; r++) {
+    int16_t raw = (int16_t) r;
+    double c = Dallas::rawToCelsius(raw);
+    double f = Dallas::rawToFahrenheit(raw);
+    if (Dallas::rawToCentiCelsius(raw) != (int32_t) round(c * 100) ||
+        Dallas::rawToMilliCelsius(raw) != (int32_t) round(c * 1000) ||
+        fabs(Dallas::rawToCentiFahrenheit(raw) - f * 100) >
+            0.5 + FLOAT_F_ERROR) {
+      if (failures++ < 5) {
+        fprintf(stderr, "raw %d: %d %d %d\n", raw,
+                Dallas::rawToCentiCelsius(raw), Dallas::rawToMilliCelsius(raw),
+                Dallas::rawToCentiFahrenheit(raw));
+      }
+    }
+  }
+  CHECK(failures == 0);
+}
+
+static void testValues(void) {
+  // halves away from zero
+  CHECK(Dallas::rawToCentiCelsius(2) == 2);  // 1.5625
+  CHECK(Dallas::rawToCentiCelsius(-2) == -2);
+  CHECK(Dallas::rawToCentiCelsius(-8) == -6);  // -6.25
+  CHECK(Dallas::rawToMilliCelsius(1) == 8);  // 7.8125
+  CHECK(Dallas::rawToMilliCelsius(-1) == -8);
+  CHECK(Dallas::rawToCentiFahrenheit(16) == 3223);  // 3222.5
+  CHECK(Dallas::rawToCentiFahrenheit(-16) == 3178);  // 3177.5
+  CHECK(Dallas::rawToCentiFahrenheit(0) == 3200);
+  CHECK(Dallas::rawToCentiFahrenheit(-40 * 128) == -4000);
+  CHECK(Dallas::rawToCentiCelsius(125 * 128) == 12500);
+  CHECK(Dallas::rawToCentiCelsius(-54 * 128) == -5400);
+
+  // disconnected
+  CHECK(Dallas::rawToCentiCelsius(DEVICE_DISCONNECTED_RAW) ==
+        DEVICE_DISCONNECTED_C * 100);
+  CHECK(Dallas::rawToCentiFahrenheit(DEVICE_DISCONNECTED_RAW) ==
+        DEVICE_DISCONNECTED_F * 100);
+  CHECK(Dallas::rawToMilliCelsius(INT16_MIN) == DEVICE_DISCONNECTED_C * 1000);
+}
+
+static void testCApi(void) {
+  int16_t raw[4] = {DEVICE_DISCONNECTED_RAW, -1, 0, 21 * 128 + 64};
+  int32_t out[4];
+  mgos_dallas_raw_to_centi_c_array(raw, out, 4);
+  CHECK(out[0] == DEVICE_DISCONNECTED_C * 100 && out[1] == -1 &&
+        out[2] == 0 && out[3] == 2150);
+  mgos_dallas_raw_to_centi_f_array(raw, out, 4);
+  CHECK(out[1] == 3199 && out[3] == 7070);
+  mgos_dallas_raw_to_milli_c_array(raw, out, 4);
+  CHECK(out[1] == -8 && out[3] == 21500);
+  CHECK(mgos_dallas_raw_to_centi_c(raw[3]) == 2150);
+  CHECK(mgos_dallas_raw_to_centi_f(raw[3]) == 7070);
+  CHECK(mgos_dallas_raw_to_milli_c(raw[3]) == 21500);
+
+  SimulatedOnewire sim(1);
+  sim.setClock(mgos_stub_micros, mgos_stub_advance);
+  sim.addDevice(0x28, 0xC01);
+  sim.setTemperature(0, -10 * 128 - 8);  // -10.0625 C
+  Dallas dallas;
+  dallas.setOneWire(&sim);
+  dallas.begin();
+  dallas.requestTemperatures();
+  uint8_t address[8];
+  CHECK(dallas.getAddress(address, 0));
+  CHECK(mgos_dallas_get_tempc(&dallas, address) == -1006);
+  CHECK(mgos_dallas_get_tempf(&dallas, address) == 1389);  // 13.8875
+  CHECK(mgos_dallas_get_tempc_by_index(&dallas, 0) == -1006);
+  CHECK(mgos_dallas_get_tempf_by_index(&dallas, 0) == 1389);
+  sim.setConnected(0, false);
+  CHECK(mgos_dallas_get_tempc(&dallas, address) ==
+        DEVICE_DISCONNECTED_C * 100);
+}
+
+int main(void) {
+  testAllRaw();
+  testValues();
+  testCApi();
+  return TEST_RESULT();
+}
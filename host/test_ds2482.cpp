@@ -0,0 +1,450 @@
+#include <mgos.h>
+#include <string.h>
+#include "DS2482Onewire.h"
+#include "Dallas.h"
+#include "SimulatedOnewire.h"
+#include "mgos_stub.h"
+#include "test.h"
+
+/*
+ * DS2482Onewire against a register model of a DS2482-100/-800 whose channels
+ * are simulated buses: channel selection and its read-back codes, the
+ * configuration register, status polling while the 1-Wire line is busy, the
+ * search triplet and the strong pullup, then Dallas on top of it.
+ */
+
+#define ADDRESS 0x1A
+
+// Status register
+#define STATUS_1WB 0x01
+#define STATUS_PPD 0x02
+#define STATUS_RST 0x10
+#define STATUS_SBR 0x20
+#define STATUS_TSB 0x40
+#define STATUS_DIR 0x80
+
+// Configuration register
+#define CONFIG_SPU 0x04
+#define CONFIG_1WS 0x08
+
+// Read pointer codes
+#define REG_STATUS 0xF0
+#define REG_DATA 0xE1
+#define REG_CHANNEL 0xD2
+#define REG_CONFIG 0xC3
+
+/*
+ * Register level model of the bridge, datasheet values. The 1-Wire commands
+ * run on the bus of the selected channel (an empty bus if none is attached),
+ * then the status register shows 1WB for busyPolls reads.
+ */
+class FakeDS2482 : public DS2482Transport {
+ public:
+  static const uint8_t channelCodes[8];
+  static const uint8_t channelReadBack[8];
+
+  FakeDS2482(bool eightChannels)
+      : busyPolls(0),
+        statusReads(0),
+        nacks(0),
+        channel(0),
+        config(0),
+        pullup(false),
+        pullupByte(0),
+        pullupWrites(0),
+        triplets(0),
+        _eightChannels(eightChannels),
+        _pointer(REG_STATUS),
+        _status(STATUS_RST),
+        _data(0xFF),
+        _busy(0) {
+    memset(_buses, 0, sizeof(_buses));
+  }
+
+  void attach(uint8_t ch, SimulatedOnewire *bus) {
+    _buses[ch] = bus;
+  }
+
+  virtual bool write(uint8_t address, const uint8_t *data, uint8_t len) {
+    if (address != ADDRESS || len == 0 || !command(data, len)) {
+      nacks++;
+      return false;
+    }
+    return true;
+  }
+
+  virtual bool read(uint8_t address, uint8_t *data, uint8_t len) {
+    if (address != ADDRESS) {
+      nacks++;
+      return false;
+    }
+    for (uint8_t i = 0; i < len; i++) {
+      data[i] = readRegister();
+    }
+    return true;
+  }
+
+  uint32_t busyPolls;  // status reads with 1WB set after a 1-Wire command
+  uint32_t statusReads;
+  uint32_t nacks;
+  uint8_t channel;
+  uint8_t config;
+  bool pullup;         // strong pullup on after a byte written with SPU
+  uint8_t pullupByte;  // last byte written with SPU
+  uint32_t pullupWrites;
+  uint32_t triplets;
+
+ private:
+  bool _eightChannels;
+  SimulatedOnewire *_buses[8];
+  uint8_t _pointer;
+  uint8_t _status;
+  uint8_t _data;
+  uint32_t _busy;
+
+  static bool needsParam(uint8_t cmd) {
+    return cmd == 0xE1 || cmd == 0xD2 || cmd == 0xC3 || cmd == 0xA5 ||
+           cmd == 0x87 || cmd == 0x78;
+  }
+
+  bool command(const uint8_t *data, uint8_t len) {
+    uint8_t cmd = data[0];
+    if (len != (needsParam(cmd) ? 2 : 1)) {
+      return false;
+    }
+    uint8_t param = data[len - 1];
+    switch (cmd) {
+      case 0xF0:  // device reset, accepted while busy
+        _busy = 0;
+        _status = STATUS_RST;
+        config = 0;
+        channel = 0;
+        pullup = false;
+        _pointer = REG_STATUS;
+        return true;
+      case 0xE1:  // set read pointer, accepted while busy
+        if (param != REG_STATUS && param != REG_DATA && param != REG_CONFIG &&
+            !(param == REG_CHANNEL && _eightChannels)) {
+          return false;
+        }
+        _pointer = param;
+        return true;
+      case 0xD2:  // write configuration, upper nibble is the complement
+        if (_busy > 0 || (param >> 4) != (~param & 0x0F)) {
+          return false;
+        }
+        config = param & 0x0F;
+        if ((config & CONFIG_SPU) == 0) {
+          pullup = false;
+        }
+        _status &= ~STATUS_RST;
+        _pointer = REG_CONFIG;
+        return true;
+      case 0xC3:  // channel select, DS2482-800 only
+        if (!_eightChannels || _busy > 0) {
+          return false;
+        }
+        for (uint8_t ch = 0; ch < 8; ch++) {
+          if (channelCodes[ch] == param) {
+            channel = ch;
+            _pointer = REG_CHANNEL;
+            return true;
+          }
+        }
+        return false;
+      case 0xB4:
+      case 0x87:
+      case 0xA5:
+      case 0x96:
+      case 0x78:
+        if (_busy > 0) {
+          return false;
+        }
+        oneWire(cmd, param);
+        _busy = busyPolls;
+        _pointer = REG_STATUS;
+        return true;
+      default:
+        return false;
+    }
+  }
+
+  /*
+   * a byte written with SPU set starts the strong pullup, it and SPU end at
+   * the next 1-Wire command
+   */
+  void oneWire(uint8_t cmd, uint8_t param) {
+    SimulatedOnewire *bus = _buses[channel];
+    if (pullup) {
+      pullup = false;
+      config &= ~CONFIG_SPU;
+    }
+    if (bus != NULL) {
+      bus->set_overdrive(config & CONFIG_1WS);
+    }
+    switch (cmd) {
+      case 0xB4: {  // 1-Wire reset
+        bool presence = (bus != NULL) && bus->reset();
+        _status = presence ? STATUS_PPD : 0;
+        break;
+      }
+      case 0x87: {  // single bit, a 1 is a read slot
+        uint8_t bit = 0;
+        if (param & 0x80) {
+          bit = (bus == NULL) || bus->read_bit();
+        } else if (bus != NULL) {
+          bus->write_bit(0);
+        }
+        _status = bit ? STATUS_SBR : 0;
+        break;
+      }
+      case 0xA5:  // write byte
+        if (bus != NULL) {
+          bus->write(param);
+        }
+        if (config & CONFIG_SPU) {
+          pullup = true;
+          pullupByte = param;
+          pullupWrites++;
+        }
+        _status = 0;
+        break;
+      case 0x96:  // read byte
+        _data = (bus != NULL) ? bus->read() : 0xFF;
+        _status = 0;
+        break;
+      case 0x78: {  // triplet: two read slots and the direction written
+        triplets++;
+        uint8_t id = (bus == NULL) || bus->read_bit();
+        uint8_t cmp = (bus == NULL) || bus->read_bit();
+        uint8_t dir = (id != cmp) ? id : (id ? 1 : (param >> 7));
+        if (bus != NULL) {
+          bus->write_bit(dir);
+        }
+        _status = (id ? STATUS_SBR : 0) | (cmp ? STATUS_TSB : 0) |
+                  (dir ? STATUS_DIR : 0);
+        break;
+      }
+    }
+  }
+
+  uint8_t readRegister(void) {
+    switch (_pointer) {
+      case REG_STATUS:
+        statusReads++;
+        if (_busy > 0) {
+          _busy--;
+          return _status | STATUS_1WB;
+        }
+        return _status;
+      case REG_DATA:
+        return _data;
+      case REG_CONFIG:
+        return config;
+      default:
+        return channelReadBack[channel];
+    }
+  }
+};
+
+const uint8_t FakeDS2482::channelCodes[8] = {0xF0, 0xE1, 0xD2, 0xC3,
+                                             0xB4, 0xA5, 0x96, 0x87};
+const uint8_t FakeDS2482::channelReadBack[8] = {0xB8, 0xB1, 0xAA, 0xA3,
+                                                0x9C, 0x95, 0x8E, 0x87};
+
+/*
+ * every channel code, the read-back codes and the channel and configuration
+ * restored at the reset of instances sharing a DS2482-800
+ */
+static void testChannels(void) {
+  FakeDS2482 bridge(true);
+  SimulatedOnewire bus3(1), bus5(1);
+  bus3.addDevice(0x28, 3);
+  bus5.addDevice(0x28, 5);
+  bridge.attach(3, &bus3);
+  bridge.attach(5, &bus5);
+
+  for (uint8_t ch = 0; ch < 8; ch++) {
+    DS2482Onewire ow(&bridge, ADDRESS, ch);
+    CHECK(ow.begin());
+    CHECK(bridge.channel == ch);
+    uint8_t readBack = 0;
+    CHECK(bridge.read(ADDRESS, &readBack, 1));
+    CHECK(readBack == FakeDS2482::channelReadBack[ch]);
+    CHECK(ow.reset() == (ch == 3 || ch == 5));
+  }
+  CHECK(!DS2482Onewire(&bridge, ADDRESS, 8).begin());
+  CHECK(!DS2482Onewire(&bridge, ADDRESS + 1, 3).begin());
+
+  DS2482Onewire ow3(&bridge, ADDRESS, 3);
+  DS2482Onewire ow5(&bridge, ADDRESS, 5);
+  CHECK(ow3.begin() && ow5.begin());
+  // overdrive on channel 5 only: standard speed devices do not answer it
+  CHECK(ow5.set_overdrive(true));
+  CHECK(bridge.config & CONFIG_1WS);
+  CHECK(ow3.reset() == 1);
+  CHECK(bridge.channel == 3 && (bridge.config & CONFIG_1WS) == 0);
+  CHECK(ow5.reset() == 0);
+  CHECK(bridge.channel == 5 && (bridge.config & CONFIG_1WS));
+  CHECK(ow5.set_overdrive(false));
+  CHECK(ow5.reset() == 1);
+
+  // a DS2482-100 has no channel selection register
+  FakeDS2482 single(false);
+  single.attach(0, &bus3);
+  CHECK(!DS2482Onewire(&single, ADDRESS, 0).begin());
+  DS2482Onewire ow(&single, ADDRESS);
+  CHECK(ow.begin());
+  CHECK(ow.reset() == 1);
+}
+
+/*
+ * the status register is polled until 1WB clears, a line stuck busy fails
+ * the command within the poll limit
+ */
+static void testStatusPolling(void) {
+  FakeDS2482 bridge(false);
+  SimulatedOnewire bus(1);
+  bus.addDevice(0x28, 1);
+  bridge.attach(0, &bus);
+  DS2482Onewire ow(&bridge, ADDRESS);
+  CHECK(ow.begin());
+
+  bridge.busyPolls = 5;
+  uint32_t before = bridge.statusReads;
+  CHECK(ow.reset() == 1);
+  CHECK(bridge.statusReads - before == 6);
+  before = bridge.statusReads;
+  ow.skip();
+  ow.write(0xBE);  // read scratchpad
+  CHECK(bridge.statusReads - before == 12);
+  uint8_t scratchPad[9];
+  ow.read_bytes(scratchPad, 9);
+  // power-on scratchpad: 85 degrees C, TH 75, TL 70
+  CHECK(scratchPad[0] == 0x50 && scratchPad[1] == 0x05);
+  CHECK(scratchPad[2] == 75 && scratchPad[3] == 70);
+
+  bridge.busyPolls = 1000;
+  before = bridge.statusReads;
+  CHECK(ow.reset() == 0);
+  CHECK(bridge.statusReads - before == 100);
+  // the bridge refuses 1-Wire commands until the line is idle
+  uint32_t nacks = bridge.nacks;
+  CHECK(ow.read() == 0xFF);
+  CHECK(ow.read_bit() == 1);
+  CHECK(bridge.nacks > nacks);
+
+  bridge.busyPolls = 0;
+  CHECK(ow.begin());
+  CHECK(ow.reset() == 1);
+}
+
+/*
+ * the triplet search must find the devices in the order of the bit-banged
+ * search, which takes the 0 branch first at every discrepancy
+ */
+static void testSearch(void) {
+  static const uint8_t families[] = {0x28, 0x28, 0x28, 0x28, 0x28,
+                                     0x28, 0x22, 0x10, 0x3B};
+  static const uint32_t serials[] = {0x000001, 0x000003, 0x000002,
+                                     0x800000, 0x800001, 0x00FF00,
+                                     0x000001, 0x000080, 0xFFFFFF};
+  const uint8_t count = sizeof(serials) / sizeof(serials[0]);
+  FakeDS2482 bridge(true);
+  SimulatedOnewire bus(count);
+  for (uint8_t i = 0; i < count; i++) {
+    bus.addDevice(families[i], serials[i]);
+  }
+  bridge.attach(6, &bus);
+  DS2482Onewire ow(&bridge, ADDRESS, 6);
+  CHECK(ow.begin());
+
+  uint8_t expected[count][8];
+  uint8_t found = 0;
+  bus.reset_search();
+  while (found < count && bus.search(expected[found])) {
+    found++;
+  }
+  CHECK(found == count);
+
+  uint8_t rom[8];
+  found = 0;
+  ow.reset_search();
+  while (ow.search(rom)) {
+    CHECK(found < count);
+    if (found < count) {
+      CHECK(memcmp(rom, expected[found], 8) == 0);
+    }
+    found++;
+  }
+  CHECK(found == count);
+  CHECK(bridge.triplets == 64u * count);
+
+  // target search: starts at the first device of the family
+  uint8_t first = 0;
+  while (first < count && expected[first][0] != 0x28) {
+    first++;
+  }
+  found = 0;
+  ow.target_search(0x28);
+  while (ow.search(rom) && rom[0] == 0x28) {
+    CHECK(memcmp(rom, expected[first + found], 8) == 0);
+    found++;
+  }
+  CHECK(found == 6);
+
+  // empty channel: no presence, no device
+  DS2482Onewire empty(&bridge, ADDRESS, 0);
+  CHECK(empty.begin());
+  empty.reset_search();
+  CHECK(empty.search(rom) == 0);
+}
+
+/*
+ * Dallas on the bridge: a parasite powered device makes the Convert T byte
+ * be written with the strong pullup, which ends at the next 1-Wire command
+ */
+static void testDallas(void) {
+  FakeDS2482 bridge(true);
+  SimulatedOnewire bus(3);
+  bus.setClock(mgos_stub_micros, mgos_stub_advance);
+  bus.addDevice(0x28, 0x11, 12);
+  bus.addDevice(0x28, 0x12, 10, true);
+  bus.addDevice(0x22, 0x13, 9);
+  for (int j = 0; j < 3; j++) {
+    bus.setTemperature(j, 128 * (21 + j));
+  }
+  bridge.attach(4, &bus);
+  bridge.busyPolls = 2;
+  DS2482Onewire ow(&bridge, ADDRESS, 4);
+  CHECK(ow.begin());
+
+  Dallas dallas;
+  dallas.setOneWire(&ow);
+  dallas.begin();
+  CHECK(dallas.getDeviceCount() == 3);
+  CHECK(dallas.isParasitePowerMode());
+
+  dallas.requestTemperatures();
+  CHECK(bridge.pullupWrites == 1 && bridge.pullupByte == 0x44);
+  CHECK(bridge.pullup);
+  for (uint8_t i = 0; i < dallas.getDeviceCount(); i++) {
+    uint8_t address[8];
+    CHECK(dallas.getAddress(address, i));
+    int j = 0;
+    while (j < 3 && memcmp(bus.getRom(j), address, 8) != 0) {
+      j++;
+    }
+    CHECK(j < 3);
+    CHECK(dallas.getTemp(address) == 128 * (21 + j));
+    CHECK(!bridge.pullup && (bridge.config & CONFIG_SPU) == 0);
+  }
+}
+
+int main(void) {
+  testChannels();
+  testStatusPolling();
+  testSearch();
+  testDallas();
+  return TEST_RESULT();
+}
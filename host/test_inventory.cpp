@@ -0,0 +1,149 @@
+#include <mgos.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "Dallas.h"
+#include "SimulatedOnewire.h"
+#include "mgos_stub.h"
+#include "test.h"
+
+/*
+ * Device inventory: begin(path) searches the bus and saves the inventory
+ * once, later boots load it without a search and can read at once. An
+ * inventory of another bus, a corrupt or an empty one is rejected and leaves
+ * the device table empty, begin(path) then searches and saves it again.
+ */
+
+#define DEVICES 5
+
+static char path[] = "/tmp/dallas_inventory_XXXXXX";
+
+static void addDevices(SimulatedOnewire *sim, uint32_t serial) {
+  sim->setClock(mgos_stub_micros, mgos_stub_advance);
+  for (int j = 0; j < DEVICES; j++) {
+    sim->addDevice((j == 2) ? 0x22 : 0x28, serial + j, 9 + j % 4, j == 3);
+    sim->setTemperature(j, 128 * (10 + j));
+  }
+}
+
+static uint32_t searches(Dallas *dallas) {
+  DallasBusStats stats;
+  CHECK(dallas->getBusStats(DALLAS_OP_BEGIN, &stats));
+  return stats.searches;
+}
+
+static bool sameTable(Dallas *a, Dallas *b) {
+  if (a->getDeviceCount() != b->getDeviceCount()) {
+    return false;
+  }
+  for (uint8_t i = 0; i < a->getDeviceCount(); i++) {
+    const Dallas::DeviceInfo *x = a->getDeviceInfo(i);
+    const Dallas::DeviceInfo *y = b->getDeviceInfo(i);
+    if (memcmp(x->address, y->address, 8) != 0 ||
+        x->resolution != y->resolution || x->parasite != y->parasite) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static void corrupt(long offset) {
+  FILE *f = fopen(path, "r+b");
+  CHECK(f != NULL);
+  fseek(f, offset, SEEK_SET);
+  int c = fgetc(f);
+  fseek(f, offset, SEEK_SET);
+  fputc(c ^ 0x01, f);
+  fclose(f);
+}
+
+int main(void) {
+  int fd = mkstemp(path);
+  CHECK(fd >= 0);
+  close(fd);
+  unlink(path);
+
+  SimulatedOnewire bus(DEVICES + 1);
+  addDevices(&bus, 0x701);
+  SimulatedOnewire other(DEVICES);
+  addDevices(&other, 0x801);
+
+  // first boot: no inventory yet, searched and saved
+  Dallas first;
+  first.setOneWire(&bus);
+  CHECK(!first.loadInventory(path));
+  CHECK(!first.begin(path));
+  CHECK(first.getDeviceCount() == DEVICES);
+  CHECK(access(path, R_OK) == 0);
+
+  // next boot: loaded without a search, readable at once
+  Dallas dallas;
+  dallas.setOneWire(&bus);
+  dallas.resetBusStats();
+  CHECK(dallas.begin(path));
+  CHECK(searches(&dallas) == 0);
+  CHECK(sameTable(&first, &dallas));
+  CHECK(dallas.isParasitePowerMode());
+  int16_t raw[DEVICES];
+  uint8_t status[DEVICES];
+  CHECK(dallas.readAll(raw, status, DEVICES) == DEVICES);
+  for (uint8_t i = 0; i < DEVICES; i++) {
+    CHECK(status[i] == DEVICE_READ_OK);
+    CHECK(raw[i] == 128 * (10 + dallas.getDeviceInfo(i)->address[1] - 1));
+  }
+
+  // a device added since the save is found by rescan()
+  bus.addDevice(0x28, 0x7FF);
+  CHECK(dallas.loadInventory(path));
+  CHECK(dallas.getDeviceCount() == DEVICES);
+  CHECK(dallas.rescan(NULL, NULL) == 1);
+  CHECK(dallas.getDeviceCount() == DEVICES + 1);
+
+  // the last device of the inventory is always verified
+  uint8_t last[8];
+  first.getAddress(last, DEVICES - 1);
+  int lastIndex = last[1] - 1;  // serial 0x701 + j
+  bus.setConnected(lastIndex, false);
+  CHECK(!dallas.loadInventory(path));
+  CHECK(dallas.getDeviceCount() == 0);
+  bus.setConnected(lastIndex, true);
+
+  // the inventory of another bus: rejected, searched and saved again
+  Dallas moved;
+  moved.setOneWire(&other);
+  CHECK(!moved.loadInventory(path));
+  CHECK(moved.getDeviceCount() == 0);
+  CHECK(!moved.isParasitePowerMode());
+  moved.resetBusStats();
+  CHECK(!moved.begin(path));
+  CHECK(searches(&moved) > 0);
+  CHECK(moved.getDeviceCount() == DEVICES);
+  for (uint8_t i = 0; i < DEVICES; i++) {
+    CHECK(moved.getDeviceInfo(i)->address[2] == 0x08);  // serial 0x801 + j
+  }
+  Dallas again;
+  again.setOneWire(&other);
+  CHECK(again.begin(path));
+  CHECK(sameTable(&moved, &again));
+
+  // a corrupt header or record
+  corrupt(4);
+  CHECK(!again.loadInventory(path));
+  CHECK(again.getDeviceCount() == 0);
+  corrupt(4);
+  CHECK(again.loadInventory(path));
+  corrupt(6 + 11 + 8);
+  CHECK(!again.loadInventory(path));
+
+  // an empty bus is not trusted
+  SimulatedOnewire empty(1);
+  empty.setClock(mgos_stub_micros, mgos_stub_advance);
+  Dallas none;
+  none.setOneWire(&empty);
+  CHECK(!none.begin(path));
+  CHECK(none.getDeviceCount() == 0);
+  CHECK(!none.loadInventory(path));
+
+  unlink(path);
+  return TEST_RESULT();
+}
@@ -0,0 +1,224 @@
+#include <mgos.h>
+#include <sys/stat.h>
+#include <string>
+#include "Dallas.h"
+#include "LinuxW1Onewire.h"
+#include "test.h"
+
+/*
+ * Dallas on LinuxW1Onewire against a fake sysfs tree of a w1 bus master with
+ * three w1_therm devices
+ */
+
+#define DEVICES 3
+
+typedef struct {
+  const char *name;
+  uint8_t scratchPad[9];
+} FakeDevice;
+
+// listed unsorted: the search returns the DS18S20 first
+static FakeDevice devices[DEVICES] = {
+    {"28-000000000101", {0x58, 0x01, 75, 70, 0x7F, 0xFF, 0x0C, 0x10, 0}},
+    {"10-000000000102", {0x2B, 0x00, 75, 70, 0xFF, 0xFF, 0x0C, 0x10, 0}},
+    {"28-000000000103", {0x30, 0xFF, 75, 70, 0x3F, 0xFF, 0x0C, 0x10, 0}},
+};
+
+static std::string master;
+
+static uint8_t crc8(const uint8_t *addr, uint8_t len) {
+  uint8_t crc = 0;
+  while (len-- > 0) {
+    uint8_t inbyte = *addr++;
+    for (int i = 8; i > 0; i--) {
+      uint8_t mix = (crc ^ inbyte) & 0x01;
+      crc >>= 1;
+      if (mix) {
+        crc ^= 0x8C;
+      }
+      inbyte >>= 1;
+    }
+  }
+  return crc;
+}
+
+static std::string attribute(const char *device, const char *file) {
+  return master + "/" + (device != NULL ? std::string(device) + "/" : "") +
+         file;
+}
+
+static void writeFile(const char *device, const char *file,
+                      const std::string &content) {
+  FILE *f = fopen(attribute(device, file).c_str(), "w");
+  CHECK(f != NULL);
+  if (f != NULL) {
+    fputs(content.c_str(), f);
+    fclose(f);
+  }
+}
+
+static std::string readFile(const char *device, const char *file) {
+  std::string content;
+  FILE *f = fopen(attribute(device, file).c_str(), "r");
+  if (f != NULL) {
+    char buf[128];
+    size_t len;
+    while ((len = fread(buf, 1, sizeof(buf), f)) > 0) {
+      content.append(buf, len);
+    }
+    fclose(f);
+  }
+  return content;
+}
+
+/*
+ * w1_slave as shown by w1_therm
+ */
+static void writeSlave(FakeDevice *dev) {
+  dev->scratchPad[8] = crc8(dev->scratchPad, 8);
+  char line[64];
+  std::string content;
+  for (int i = 0; i < 9; i++) {
+    snprintf(line, sizeof(line), "%02x ", dev->scratchPad[i]);
+    content += line;
+  }
+  snprintf(line, sizeof(line), ": crc=%02x YES\n", dev->scratchPad[8]);
+  std::string bytes = content;
+  content += line;
+  content += bytes + "t=21500\n";
+  writeFile(dev->name, "w1_slave", content);
+}
+
+static void createTree(void) {
+  char dir[] = "/tmp/w1_therm_XXXXXX";
+  CHECK(mkdtemp(dir) != NULL);
+  master = dir;
+  std::string slaves;
+  for (int i = 0; i < DEVICES; i++) {
+    mkdir(attribute(devices[i].name, "").c_str(), 0755);
+    writeSlave(&devices[i]);
+    writeFile(devices[i].name, "ext_power", "1\n");
+    char resolution[8];
+    snprintf(resolution, sizeof(resolution), "%d\n",
+             ((devices[i].scratchPad[4] >> 5) & 0x03) + 9);
+    writeFile(devices[i].name, "resolution", resolution);
+    writeFile(devices[i].name, "alarms", "70 75\n");
+    writeFile(devices[i].name, "eeprom_cmd", "");
+    slaves += std::string(devices[i].name) + "\n";
+  }
+  writeFile(NULL, "w1_master_slaves", slaves);
+  writeFile(NULL, "w1_master_slave_count", "3\n");
+  writeFile(NULL, "therm_bulk_read", "0\n");
+}
+
+static void removeTree(void) {
+  std::string command = "rm -rf " + master;
+  CHECK(system(command.c_str()) == 0);
+}
+
+/*
+ * index in devices[] of the device at Dallas index i
+ */
+static int fakeIndex(Dallas *dallas, uint8_t i) {
+  uint8_t address[8];
+  dallas->getAddress(address, i);
+  char name[16];
+  snprintf(name, sizeof(name), "%02x-%02x%02x%02x%02x%02x%02x", address[0],
+           address[6], address[5], address[4], address[3], address[2],
+           address[1]);
+  for (int j = 0; j < DEVICES; j++) {
+    if (strcmp(devices[j].name, name) == 0) {
+      return j;
+    }
+  }
+  return -1;
+}
+
+int main(void) {
+  createTree();
+  LinuxW1Onewire ow(master.c_str());
+  Dallas dallas;
+  dallas.setOneWire(&ow);
+  dallas.begin();
+
+  // search: all devices, sorted by family, valid CRC
+  CHECK(dallas.getDeviceCount() == DEVICES);
+  int index[DEVICES];
+  uint8_t address[DEVICES][8];
+  for (uint8_t i = 0; i < DEVICES; i++) {
+    index[i] = fakeIndex(&dallas, i);
+    CHECK(index[i] >= 0);
+    dallas.getAddress(address[i], i);
+    CHECK(dallas.validAddress(address[i]));
+  }
+  CHECK(address[0][0] == 0x10);
+  CHECK(!dallas.isParasitePowerMode());
+
+  // scratchpad before a conversion: not w1_slave, which would make the
+  // kernel convert the device, but the attributes and the power-on value
+  for (uint8_t i = 0; i < DEVICES; i++) {
+    uint8_t scratchPad[9];
+    const uint8_t *expected = devices[index[i]].scratchPad;
+    CHECK(dallas.readScratchPad(address[i], scratchPad));
+    CHECK(scratchPad[8] == crc8(scratchPad, 8));
+    CHECK(memcmp(&scratchPad[2], &expected[2], i == 0 ? 2 : 3) == 0);
+    CHECK(scratchPad[0] == (i == 0 ? 0xAA : 0x50));
+  }
+  CHECK(dallas.getResolution(address[1]) == 12);
+  CHECK(dallas.getResolution(address[2]) == 10);
+
+  // presence: the device directory
+  uint8_t missing[8];
+  memcpy(missing, address[1], 8);
+  missing[1] ^= 0x80;
+  CHECK(dallas.isConnected(address[1]));
+  CHECK(!dallas.isConnected(missing));
+
+  // convert T: therm_bulk_read, polled by a read slot
+  dallas.startConversion();
+  CHECK(readFile(NULL, "therm_bulk_read") == "trigger\n");
+  writeFile(NULL, "therm_bulk_read", "-1\n");
+  CHECK(!dallas.isConversionComplete());
+  writeFile(NULL, "therm_bulk_read", "1\n");
+  CHECK(dallas.isConversionComplete());
+
+  // scratchpad after it: w1_slave, once per device, then the last reading
+  for (uint8_t i = 0; i < DEVICES; i++) {
+    uint8_t scratchPad[9];
+    CHECK(dallas.readScratchPad(address[i], scratchPad));
+    CHECK(memcmp(scratchPad, devices[index[i]].scratchPad, 9) == 0);
+    writeFile(devices[index[i]].name, "w1_slave", "converting\n");
+  }
+  CHECK(dallas.getTemp(address[1]) == 0x0158 << 3);
+  CHECK(dallas.getTemp(address[2]) == -208 * 8);  // 0xFF30
+
+  // read power supply: ext_power, any parasite device after skip rom
+  CHECK(!dallas.readPowerSupply(NULL));
+  writeFile(devices[index[2]].name, "ext_power", "0\n");
+  CHECK(dallas.readPowerSupply(NULL));
+  CHECK(dallas.readPowerSupply(address[2]));
+  CHECK(!dallas.readPowerSupply(address[1]));
+  // not provided by the kernel: external power
+  for (int j = 0; j < DEVICES; j++) {
+    remove(attribute(devices[j].name, "ext_power").c_str());
+  }
+  CHECK(!dallas.readPowerSupply(NULL));
+  CHECK(!dallas.readPowerSupply(address[2]));
+
+  // write scratchpad: alarms and resolution, not for the DS18S20
+  dallas.setAlarmThresholds(address[1], -5, 30);
+  CHECK(readFile(devices[index[1]].name, "alarms") == "-5 30\n");
+  dallas.setResolution(address[1], 9, true);
+  CHECK(readFile(devices[index[1]].name, "resolution") == "9\n");
+
+  // broadcast write scratchpad and copy scratchpad
+  dallas.setResolution(11, true, false);
+  for (uint8_t i = 0; i < DEVICES; i++) {
+    const char *name = devices[index[i]].name;
+    CHECK(readFile(name, "resolution") == (i == 0 ? "12\n" : "11\n"));
+    CHECK(readFile(name, "eeprom_cmd") == "save\n");
+  }
+
+  removeTree();
+  return TEST_RESULT();
+}
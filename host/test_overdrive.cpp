@@ -0,0 +1,76 @@
+#include <mgos.h>
+#include "Dallas.h"
+#include "SimulatedOnewire.h"
+#include "mgos_stub.h"
+#include "test.h"
+
+/*
+ * A DS28EA00 is read at overdrive speed: a glitch (CRC error, missing
+ * presence) is retried at standard speed without dropping the overdrive
+ * speed, only repeated failures at overdrive speed alone do.
+ */
+
+#define DEVICES 2
+
+static SimulatedOnewire sim(DEVICES);
+static Dallas dallas;
+static uint8_t address[8];  // the DS28EA00
+static int simIndex;
+static uint8_t dallasIndex;
+
+static bool overdrive(void) {
+  return dallas.getDeviceInfo(dallasIndex)->overdrive;
+}
+
+int main(void) {
+  sim.setClock(mgos_stub_micros, mgos_stub_advance);
+  sim.addDevice(0x28, 0x601);
+  simIndex = sim.addDevice(0x42, 0x602);
+  sim.setTemperature(simIndex, 128 * 23);
+  dallas.setOneWire(&sim);
+  dallas.begin();
+  CHECK(dallas.getDeviceCount() == DEVICES);
+  dallasIndex = (dallas.getDeviceInfo(0)->family == 0x42) ? 0 : 1;
+  dallas.getAddress(address, dallasIndex);
+  dallas.requestTemperatures();
+
+  CHECK(dallas.getTemp(address) == 128 * 23);
+  CHECK(overdrive());
+
+  // one CRC error: read again at standard speed, overdrive kept
+  sim.injectCrcErrors(simIndex, 1);
+  CHECK(dallas.getTemp(address) == 128 * 23);
+  CHECK(overdrive());
+  CHECK(dallas.getDeviceInfo(dallasIndex)->overdriveFailures == 1);
+  CHECK(dallas.getTemp(address) == 128 * 23);
+  CHECK(dallas.getDeviceInfo(dallasIndex)->overdriveFailures == 0);
+
+  // one missing presence pulse
+  sim.injectMissingPresence(1);
+  CHECK(dallas.isConnected(address));
+  CHECK(overdrive());
+  CHECK(dallas.isConnected(address));
+  CHECK(dallas.getDeviceInfo(dallasIndex)->overdriveFailures == 0);
+
+  // gone at both speeds: not an overdrive failure
+  sim.setConnected(simIndex, false);
+  CHECK(!dallas.isConnected(address));
+  CHECK(!dallas.isConnected(address));
+  CHECK(!dallas.isConnected(address));
+  CHECK(overdrive());
+  sim.setConnected(simIndex, true);
+
+  // failing at overdrive speed only, read after read: standard speed
+  int16_t raw[DEVICES];
+  uint8_t status[DEVICES];
+  for (int i = 0; i < 3; i++) {
+    CHECK(overdrive());
+    sim.injectCrcErrors(simIndex, 1);
+    CHECK(dallas.readAllResults(raw, status, DEVICES) == DEVICES);
+    CHECK(status[dallasIndex] == DEVICE_READ_OK);
+    CHECK(raw[dallasIndex] == 128 * 23);
+  }
+  CHECK(!overdrive());
+  CHECK(dallas.getTemp(address) == 128 * 23);
+  return TEST_RESULT();
+}
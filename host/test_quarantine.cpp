@@ -0,0 +1,138 @@
+#include <mgos.h>
+#include "Dallas.h"
+#include "SimulatedOnewire.h"
+#include "mgos_stub.h"
+#include "test.h"
+
+/*
+ * Quarantine of failing devices: after the threshold of consecutive failed
+ * reads a device is skipped without bus traffic, retried after 1, 2, 4, ...
+ * up to 64 skipped reads, and back to normal after one good read. The other
+ * devices are read as usual.
+ */
+
+#define DEVICES 3
+#define THRESHOLD 2
+#define SCRATCHPAD_BITS 72
+
+static SimulatedOnewire sim(DEVICES);
+static Dallas dallas;
+static uint8_t failing;  // Dallas index of the failing device
+static int simIndex;
+
+static uint8_t readFailing(void) {
+  int16_t raw[DEVICES];
+  uint8_t status[DEVICES];
+  uint8_t ok = dallas.readAllResults(raw, status, DEVICES);
+  for (uint8_t i = 0; i < DEVICES; i++) {
+    if (i != failing) {
+      CHECK(status[i] == DEVICE_READ_OK);
+    }
+  }
+  CHECK(ok == DEVICES - (status[failing] != DEVICE_READ_OK));
+  if (status[failing] != DEVICE_READ_OK) {
+    CHECK(raw[failing] == DEVICE_DISCONNECTED_RAW);
+  }
+  return status[failing];
+}
+
+/*
+ * counts the reads skipped before the next retry, which must fail
+ */
+static int skippedReads(void) {
+  int skipped = 0;
+  uint8_t st;
+  while ((st = readFailing()) == DEVICE_READ_QUARANTINED && skipped < 100) {
+    skipped++;
+  }
+  CHECK(st == DEVICE_READ_CRC_ERROR);
+  return skipped;
+}
+
+static void testBackoff(void) {
+  dallas.setQuarantineThreshold(THRESHOLD);
+  sim.setConnected(simIndex, false);
+  for (int i = 0; i < THRESHOLD; i++) {
+    CHECK(!dallas.isQuarantined(failing));
+    CHECK(readFailing() == DEVICE_READ_CRC_ERROR);
+  }
+  CHECK(dallas.isQuarantined(failing));
+
+  // a skipped read does not touch the device
+  uint32_t before = sim.getStats().bitsRead;
+  CHECK(readFailing() == DEVICE_READ_QUARANTINED);
+  CHECK(sim.getStats().bitsRead - before == (DEVICES - 1) * SCRATCHPAD_BITS);
+  CHECK(readFailing() == DEVICE_READ_CRC_ERROR);
+
+  int expected[] = {2, 4, 8, 16, 32, 64, 64};
+  for (size_t i = 0; i < sizeof(expected) / sizeof(expected[0]); i++) {
+    CHECK(skippedReads() == expected[i]);
+  }
+  const Dallas::DeviceInfo *info = dallas.getDeviceInfo(failing);
+  CHECK(info->crcErrors == THRESHOLD + 1 + 7);
+  CHECK(info->consecutiveErrors == THRESHOLD + 1 + 7);
+
+  // getTemp() is skipped as well
+  uint8_t address[8];
+  dallas.getAddress(address, failing);
+  CHECK(dallas.getTemp(address) == DEVICE_DISCONNECTED_RAW);
+  CHECK(readFailing() == DEVICE_READ_QUARANTINED);
+
+  // back: read at the next retry, the quarantine ends
+  sim.setConnected(simIndex, true);
+  int skipped = 0;
+  while (readFailing() == DEVICE_READ_QUARANTINED && skipped < 100) {
+    skipped++;
+  }
+  CHECK(skipped == 64 - 2);
+  CHECK(!dallas.isQuarantined(failing));
+  CHECK(info->consecutiveErrors == 0 && info->quarantineSkips == 0);
+  CHECK(info->crcErrors > 0);
+  for (int i = 0; i < 3; i++) {
+    CHECK(readFailing() == DEVICE_READ_OK);
+  }
+  CHECK(dallas.getTemp(address) == 128 * 30);
+}
+
+static void testReset(void) {
+  sim.setConnected(simIndex, false);
+  for (int i = 0; i < THRESHOLD; i++) {
+    readFailing();
+  }
+  CHECK(dallas.isQuarantined(failing));
+  dallas.resetDeviceErrors();
+  CHECK(!dallas.isQuarantined(failing));
+  CHECK(dallas.getDeviceInfo(failing)->crcErrors == 0);
+  CHECK(readFailing() == DEVICE_READ_CRC_ERROR);
+
+  // no threshold: never skipped, the errors are still counted
+  dallas.setQuarantineThreshold(0);
+  for (int i = 0; i < 2 * THRESHOLD; i++) {
+    CHECK(readFailing() == DEVICE_READ_CRC_ERROR);
+    CHECK(!dallas.isQuarantined(failing));
+  }
+  CHECK(dallas.getDeviceInfo(failing)->consecutiveErrors == 1 + 2 * THRESHOLD);
+  sim.setConnected(simIndex, true);
+  CHECK(readFailing() == DEVICE_READ_OK);
+}
+
+int main(void) {
+  sim.setClock(mgos_stub_micros, mgos_stub_advance);
+  sim.addDevice(0x28, 0x901);
+  simIndex = sim.addDevice(0x28, 0x902);
+  sim.addDevice(0x28, 0x903);
+  sim.setTemperature(simIndex, 128 * 30);
+  dallas.setOneWire(&sim);
+  dallas.begin();
+  CHECK(dallas.getDeviceCount() == DEVICES);
+  for (uint8_t i = 0; i < DEVICES; i++) {
+    if (dallas.getDeviceInfo(i)->address[1] == 0x02) {
+      failing = i;
+    }
+  }
+  dallas.requestTemperatures();
+
+  testBackoff();
+  testReset();
+  return TEST_RESULT();
+}
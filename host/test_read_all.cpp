@@ -0,0 +1,57 @@
+#include <mgos.h>
+#include "Dallas.h"
+#include "SimulatedOnewire.h"
+#include "mgos_stub.h"
+#include "test.h"
+
+/*
+ * Blocking readAll() right after begin(), while the uptime is still below the
+ * conversion time: it must wait for the conversion (polling the bus or for
+ * the datasheet time) and sleep between the polls instead of spinning on the
+ * bus.
+ */
+
+#define DEVICES 3
+#define POWER_ON_RAW (85 * 128)
+
+static void testReadAll(bool parasite, bool checkForConversion) {
+  SimulatedOnewire sim(DEVICES);
+  sim.setClock(mgos_stub_micros, mgos_stub_advance);
+  for (int j = 0; j < DEVICES; j++) {
+    sim.addDevice(0x28, 0x200 + j, 12, parasite);
+    sim.setTemperature(j, 128 * (18 + j));
+  }
+
+  Dallas dallas;
+  dallas.setOneWire(&sim);
+  dallas.setCheckForConversion(checkForConversion);
+  dallas.begin();
+  CHECK(dallas.getDeviceCount() == DEVICES);
+
+  int16_t raw[DEVICES];
+  uint8_t status[DEVICES];
+  uint64_t start = mgos_stub_micros();
+  sim.resetStats();
+  CHECK(dallas.readAll(raw, status, DEVICES) == DEVICES);
+  uint64_t waited = mgos_stub_micros() - start;
+
+  // 750 ms conversion, the scratchpad reads take about 12 ms each
+  CHECK(waited >= 750000 && waited < 750000 + 60000);
+  // one read slot per poll, not a busy loop, plus the scratchpads
+  CHECK(sim.getStats().bitsRead < 100 + DEVICES * 72);
+  for (uint8_t i = 0; i < DEVICES; i++) {
+    uint8_t address[8];
+    dallas.getAddress(address, i);
+    CHECK(status[i] == DEVICE_READ_OK);
+    CHECK(raw[i] != POWER_ON_RAW);
+    CHECK(raw[i] == 128 * (18 + address[1]));  // serial 0x200 + j
+  }
+}
+
+int main(void) {
+  // the first test runs at boot: uptime 0
+  testReadAll(false, true);
+  testReadAll(false, false);
+  testReadAll(true, true);
+  return TEST_RESULT();
+}
@@ -0,0 +1,110 @@
+#include <mgos.h>
+#include <string.h>
+#include "Dallas.h"
+#include "SimulatedOnewire.h"
+#include "mgos_stub.h"
+#include "test.h"
+
+/*
+ * rescan(): an unchanged bus reports nothing and reads no scratchpad, removed
+ * devices are reported and dropped keeping the order of the others, added
+ * devices are reported after them and appended with their resolution read.
+ */
+
+#define MAX_DEVICES 6
+#define SEARCH_BITS_READ 128  // 64 triplets of two read slots
+
+static SimulatedOnewire sim(MAX_DEVICES);
+static Dallas dallas;
+
+static struct {
+  uint8_t address[8];
+  bool added;
+} changes[MAX_DEVICES];
+static int changeCount;
+
+static void changeCb(Dallas *d, const uint8_t *deviceAddress, bool added,
+                     void *arg) {
+  CHECK(d == &dallas);
+  CHECK(arg == &changeCount);
+  if (changeCount < MAX_DEVICES) {
+    memcpy(changes[changeCount].address, deviceAddress, 8);
+    changes[changeCount].added = added;
+  }
+  changeCount++;
+}
+
+/*
+ * the sim index of the device at index, its serial is 0x301 + sim index
+ */
+static int simIndex(uint8_t index) {
+  return dallas.getDeviceInfo(index)->address[1] - 1;
+}
+
+static uint16_t rescan(void) {
+  changeCount = 0;
+  return dallas.rescan(changeCb, &changeCount);
+}
+
+int main(void) {
+  sim.setClock(mgos_stub_micros, mgos_stub_advance);
+  sim.addDevice(0x28, 0x301, 9);
+  sim.addDevice(0x28, 0x302, 10, true);
+  sim.addDevice(0x22, 0x303, 11);
+  sim.addDevice(0x28, 0x304, 12);
+  dallas.setOneWire(&sim);
+  dallas.begin();
+  CHECK(dallas.getDeviceCount() == 4);
+  CHECK(dallas.isParasitePowerMode());
+  int order[4];
+  for (uint8_t i = 0; i < 4; i++) {
+    order[i] = simIndex(i);
+  }
+
+  // unchanged: search steps only, one reset each
+  sim.resetStats();
+  CHECK(rescan() == 0);
+  CHECK(changeCount == 0);
+  CHECK(dallas.getDeviceCount() == 4);
+  CHECK(sim.getStats().resets > 0);
+  CHECK(sim.getStats().bitsRead == sim.getStats().resets * SEARCH_BITS_READ);
+
+  // the parasite powered device leaves, a new one comes
+  sim.setConnected(1, false);
+  int added = sim.addDevice(0x28, 0x305, 10);
+  CHECK(rescan() == 2);
+  CHECK(changeCount == 2);
+  CHECK(!changes[0].added && memcmp(changes[0].address, sim.getRom(1), 8) == 0);
+  CHECK(changes[1].added &&
+        memcmp(changes[1].address, sim.getRom(added), 8) == 0);
+  CHECK(dallas.getDeviceCount() == 4);
+  CHECK(!dallas.isParasitePowerMode());
+  uint8_t j = 0;
+  for (uint8_t i = 0; i < 4; i++) {
+    if (order[i] != 1) {
+      CHECK(simIndex(j++) == order[i]);
+    }
+  }
+  CHECK(simIndex(3) == added);
+  CHECK(dallas.getDeviceInfo(3)->resolution == 10);
+
+  // back again: appended after the new one
+  sim.setConnected(1, true);
+  CHECK(rescan() == 1);
+  CHECK(changeCount == 1 && changes[0].added);
+  CHECK(dallas.getDeviceCount() == 5);
+  CHECK(simIndex(4) == 1);
+  CHECK(dallas.getDeviceInfo(4)->resolution == 10);
+  CHECK(dallas.isParasitePowerMode());
+
+  // a NULL callback still updates the table
+  sim.setConnected(0, false);
+  sim.setConnected(2, false);
+  CHECK(dallas.rescan(NULL, NULL) == 2);
+  CHECK(dallas.getDeviceCount() == 3);
+  for (uint8_t i = 0; i < 3; i++) {
+    CHECK(simIndex(i) != 0 && simIndex(i) != 2);
+  }
+  CHECK(simIndex(1) == added && simIndex(2) == 1);
+  return TEST_RESULT();
+}
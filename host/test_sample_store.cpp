@@ -0,0 +1,143 @@
+#include <mgos.h>
+#include "Dallas.h"
+#include "DallasSampleStore.h"
+#include "SimulatedOnewire.h"
+#include "mgos_stub.h"
+#include "test.h"
+
+/*
+ * DallasSampleStore: the sample ring, rollups over aligned windows, samples
+ * arriving out of order and the uptime wrap, then the samples recorded by
+ * the readAll() of a Dallas object.
+ */
+
+static const uint8_t rom1[8] = {0x28, 1, 0, 0, 0, 0, 0, 0};
+static const uint8_t rom2[8] = {0x28, 2, 0, 0, 0, 0, 0, 0};
+
+static void testRing(void) {
+  DallasSampleStore store;
+  DallasSampleStore::Sample samples[DALLAS_SAMPLE_DEPTH];
+  CHECK(!store.getLast(rom1, samples));
+  for (int i = 0; i < DALLAS_SAMPLE_DEPTH + 5; i++) {
+    CHECK(store.add(rom1, 100 * i, i));
+  }
+  CHECK(store.add(rom2, 7, -7));
+
+  // the oldest samples are overwritten
+  CHECK(store.getSamples(rom1, samples, DALLAS_SAMPLE_DEPTH) ==
+        DALLAS_SAMPLE_DEPTH);
+  CHECK(samples[0].raw == 5 && samples[0].time == 500);
+  CHECK(samples[DALLAS_SAMPLE_DEPTH - 1].raw == DALLAS_SAMPLE_DEPTH + 4);
+  CHECK(store.getSamples(rom1, samples, 2) == 2);
+  CHECK(samples[1].raw == DALLAS_SAMPLE_DEPTH + 4);
+  CHECK(store.getLast(rom2, samples) && samples[0].raw == -7);
+
+  store.clear(rom1);
+  CHECK(store.getSamples(rom1, samples, 1) == 0);
+  CHECK(store.getLast(rom2, samples));
+}
+
+static void testRollups(void) {
+  DallasSampleStore store;
+  DallasSampleStore::Rollup rollup;
+  CHECK(store.setWindow(0, 1000));
+  CHECK(store.setWindow(1, 10000));
+  CHECK(!store.setWindow(DALLAS_SAMPLE_WINDOWS, 1000));
+
+  // window [1000, 2000): mean rounded to nearest, halves away from zero
+  store.add(rom1, 1100, 10);
+  store.add(rom1, 1500, -3);
+  store.add(rom1, 1999, 6);
+  store.add(rom1, 1999, 8);
+  CHECK(!store.getRollup(rom1, 0, false, &rollup));
+  CHECK(store.getRollup(rom1, 0, true, &rollup));
+  CHECK(rollup.start == 1000 && rollup.count == 4);
+  CHECK(rollup.min == -3 && rollup.max == 10 && rollup.mean == 5);
+
+  // the next window completes it
+  store.add(rom1, 2400, -9);
+  CHECK(store.getRollup(rom1, 0, false, &rollup));
+  CHECK(rollup.start == 1000 && rollup.count == 4 && rollup.mean == 5);
+  CHECK(store.getRollup(rom1, 0, true, &rollup));
+  CHECK(rollup.start == 2000 && rollup.count == 1 && rollup.mean == -9);
+  store.add(rom1, 2500, -10);
+  CHECK(store.getRollup(rom1, 0, true, &rollup) && rollup.mean == -10);
+
+  // a late sample is counted in the window being filled, the completed one
+  // stays in place
+  store.add(rom1, 900, 50);
+  CHECK(store.getRollup(rom1, 0, true, &rollup));
+  CHECK(rollup.start == 2000 && rollup.count == 3 && rollup.max == 50);
+  CHECK(store.getRollup(rom1, 0, false, &rollup));
+  CHECK(rollup.start == 1000 && rollup.count == 4);
+
+  // the long window holds everything so far
+  CHECK(store.getRollup(rom1, 1, true, &rollup));
+  CHECK(rollup.start == 0 && rollup.count == 7);
+  CHECK(rollup.min == -10 && rollup.max == 50);
+
+  // changing a window clears its rollups only
+  CHECK(store.setWindow(0, 500));
+  CHECK(!store.getRollup(rom1, 0, true, &rollup));
+  CHECK(store.getRollup(rom1, 1, true, &rollup));
+}
+
+/*
+ * the window started before the wrap of the millisecond uptime is completed
+ * by the first sample after it
+ */
+static void testWrap(void) {
+  DallasSampleStore store;
+  DallasSampleStore::Rollup rollup;
+  CHECK(store.setWindow(0, 1000));
+  // the last window before the wrap starts at 4294967000
+  store.add(rom1, UINT32_MAX - 200, 1);
+  store.add(rom1, UINT32_MAX - 10, 2);
+  store.add(rom1, 300, 3);
+  CHECK(!store.getRollup(rom1, 0, false, &rollup));
+  store.add(rom1, 800, 4);
+  CHECK(store.getRollup(rom1, 0, false, &rollup) && rollup.count == 3);
+  CHECK(store.getRollup(rom1, 0, true, &rollup));
+  CHECK(rollup.start == 0 && rollup.count == 1);
+}
+
+static void testDallas(void) {
+  SimulatedOnewire sim(2);
+  sim.setClock(mgos_stub_micros, mgos_stub_advance);
+  sim.addDevice(0x28, 0x501);
+  sim.addDevice(0x28, 0x502);
+  Dallas dallas;
+  dallas.setOneWire(&sim);
+  dallas.begin();
+  DallasSampleStore store;
+  store.setWindow(0, 60000);
+  dallas.setSampleStore(&store);
+
+  int16_t raw[2];
+  for (int i = 0; i < 3; i++) {
+    sim.setTemperature(0, 128 * (20 + i));
+    sim.setTemperature(1, 128 * (30 - i));
+    CHECK(dallas.readAll(raw, NULL, 2) == 2);
+  }
+  for (uint8_t i = 0; i < 2; i++) {
+    uint8_t address[8];
+    dallas.getAddress(address, i);
+    int j = address[1] - 1;  // serial 0x501 + j
+    DallasSampleStore::Sample samples[4];
+    CHECK(store.getSamples(address, samples, 4) == 3);
+    CHECK(samples[2].raw == raw[i]);
+    CHECK(samples[0].time < samples[1].time);
+    CHECK(samples[2].time <= (uint32_t)(mgos_uptime() * 1000));
+    DallasSampleStore::Rollup rollup;
+    CHECK(store.getRollup(address, 0, true, &rollup));
+    CHECK(rollup.count == 3 && rollup.mean == 128 * (j == 0 ? 21 : 29));
+  }
+}
+
+int main(void) {
+  testRing();
+  testRollups();
+  testWrap();
+  testDallas();
+  return TEST_RESULT();
+}
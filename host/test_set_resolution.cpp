@@ -0,0 +1,123 @@
+#include <mgos.h>
+#include "Dallas.h"
+#include "SimulatedOnewire.h"
+#include "mgos_stub.h"
+#include "test.h"
+
+/*
+ * setResolution() for the whole bus: one Skip ROM write while the alarm
+ * registers of all devices are cached and equal, one write per configurable
+ * device otherwise, and the verify pass reading every device back.
+ */
+
+#define DEVICES 4
+#define SKIP_WRITE_BITS (8 + 8 + 3 * 8)  // Skip ROM, command, TH TL config
+
+static SimulatedOnewire sim(DEVICES);
+static Dallas dallas;
+static uint8_t addresses[DEVICES][8];
+
+/*
+ * checks the configuration register read from every device
+ */
+static void checkResolution(uint8_t resolution) {
+  for (uint8_t i = 0; i < DEVICES; i++) {
+    uint8_t scratchPad[9];
+    CHECK(dallas.readScratchPad(addresses[i], scratchPad));
+    if (addresses[i][0] != 0x10) {
+      CHECK(scratchPad[4] == (((resolution - 9) << 5) | 0x1F));
+      CHECK(dallas.getResolution(addresses[i]) == resolution);
+    }
+    CHECK(scratchPad[2] == 75 && scratchPad[3] == 70);
+  }
+}
+
+static void testBroadcast(void) {
+  // the registers of the DS18S20 are not cached by begin(): one write per
+  // configurable device
+  sim.resetStats();
+  CHECK(dallas.setResolution(10, false, false));
+  CHECK(sim.getStats().resets > 2);
+  checkResolution(10);
+
+  // the scratchpads read cache the equal alarm registers
+  int16_t raw[DEVICES];
+  CHECK(dallas.readAll(raw, NULL, DEVICES) == DEVICES);
+  sim.resetStats();
+  CHECK(dallas.setResolution(11, false, false));
+  CHECK(sim.getStats().resets == 2);
+  CHECK(sim.getStats().bitsWritten == SKIP_WRITE_BITS);
+  CHECK(sim.getStats().bitsRead == 0);
+  checkResolution(11);
+
+  // nothing to change: no write
+  sim.resetStats();
+  CHECK(dallas.setResolution(11, false, false));
+  CHECK(sim.getStats().resets == 0);
+
+  // the verify pass reads every device back
+  sim.resetStats();
+  CHECK(dallas.setResolution(9, false, true));
+  CHECK(sim.getStats().bitsRead == DEVICES * 72);
+  checkResolution(9);
+  CHECK(dallas.getResolution() == 9);
+
+  // copied to the EEPROM with one Skip ROM copy
+  sim.resetStats();
+  CHECK(dallas.setResolution(12, true, false));
+  CHECK(sim.getStats().resets == 2 + 2);
+  CHECK(sim.getStats().bitsWritten == SKIP_WRITE_BITS + 16);
+  checkResolution(12);
+}
+
+static void testPerDevice(void) {
+  // different alarm registers: written one by one, each with its own
+  uint8_t device = (addresses[0][0] == 0x10) ? 1 : 0;
+  CHECK(dallas.setAlarmThresholds(addresses[device], -10, 40));
+  sim.resetStats();
+  CHECK(dallas.setResolution(10, false, true));
+  CHECK(sim.getStats().resets > 2 + DEVICES * 2);
+  for (uint8_t i = 0; i < DEVICES; i++) {
+    uint8_t scratchPad[9];
+    CHECK(dallas.readScratchPad(addresses[i], scratchPad));
+    if (addresses[i][0] != 0x10) {
+      CHECK(scratchPad[4] == ((1 << 5) | 0x1F));
+    }
+    if (i == device) {
+      CHECK((int8_t) scratchPad[2] == 40 && (int8_t) scratchPad[3] == -10);
+    } else {
+      CHECK(scratchPad[2] == 75 && scratchPad[3] == 70);
+    }
+  }
+  CHECK(dallas.setAlarmThresholds(addresses[device], 70, 75));
+}
+
+static void testVerifyFails(void) {
+  uint8_t device = (addresses[0][0] == 0x10) ? 1 : 0;
+  int simIndex = addresses[device][1] - 1;  // serial 0xA01 + j
+  sim.setConnected(simIndex, false);
+  CHECK(!dallas.setResolution(11, false, true));
+  // without the verify pass the missing device is not noticed
+  CHECK(dallas.setResolution(12, false, false));
+  sim.setConnected(simIndex, true);
+  CHECK(dallas.setResolution(12, false, true));
+  checkResolution(12);
+}
+
+int main(void) {
+  sim.setClock(mgos_stub_micros, mgos_stub_advance);
+  sim.addDevice(0x28, 0xA01, 12);
+  sim.addDevice(0x22, 0xA02, 10);
+  sim.addDevice(0x10, 0xA03);
+  sim.addDevice(0x3B, 0xA04, 9);
+  dallas.setOneWire(&sim);
+  dallas.begin();
+  CHECK(dallas.getDeviceCount() == DEVICES);
+  for (uint8_t i = 0; i < DEVICES; i++) {
+    dallas.getAddress(addresses[i], i);
+  }
+  testBroadcast();
+  testPerDevice();
+  testVerifyFails();
+  return TEST_RESULT();
+}
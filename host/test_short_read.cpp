@@ -0,0 +1,110 @@
+#include <mgos.h>
+#include "Dallas.h"
+#include "SimulatedOnewire.h"
+#include "mgos_stub.h"
+#include "test.h"
+
+/*
+ * Short scratchpad reads: only the 2 temperature bytes of a plausible value
+ * are read, the power-on value falls back to the full scratchpad, -0.0625 C
+ * (all ones) is a valid reading and the DS18S20 is always read in full.
+ */
+
+#define DEVICES 4
+#define POWER_ON_RAW (85 * 128)
+#define SHORT_BITS 16
+#define FULL_BITS 72
+
+static SimulatedOnewire sim(DEVICES);
+static Dallas dallas;
+static uint8_t addresses[DEVICES][8];
+static int simIndex[DEVICES];
+
+static uint32_t bitsRead(void) {
+  return sim.getStats().bitsRead;
+}
+
+/*
+ * sets the temperatures by Dallas index and converts
+ */
+static void convert(const int16_t *raw) {
+  for (uint8_t i = 0; i < DEVICES; i++) {
+    sim.setTemperature(simIndex[i], raw[i]);
+  }
+  dallas.requestTemperatures();
+}
+
+int main(void) {
+  sim.setClock(mgos_stub_micros, mgos_stub_advance);
+  sim.addDevice(0x28, 0x401);
+  sim.addDevice(0x28, 0x402);
+  sim.addDevice(0x22, 0x403);
+  sim.addDevice(0x10, 0x404);
+  dallas.setOneWire(&sim);
+  dallas.begin();
+  dallas.setShortRead(true);
+  CHECK(dallas.getDeviceCount() == DEVICES);
+  uint8_t ds18s20 = DEVICES;
+  for (uint8_t i = 0; i < DEVICES; i++) {
+    dallas.getAddress(addresses[i], i);
+    simIndex[i] = addresses[i][1] - 1;  // serial 0x401 + j
+    if (addresses[i][0] == 0x10) {
+      ds18s20 = i;
+    }
+  }
+  CHECK(ds18s20 < DEVICES);
+  uint8_t device = (ds18s20 == 0) ? 1 : 0;
+
+  // power-on value: confirmed by the full scratchpad and its CRC
+  uint32_t before = bitsRead();
+  CHECK(dallas.getTemp(addresses[device]) == POWER_ON_RAW);
+  CHECK(bitsRead() - before == SHORT_BITS + FULL_BITS);
+
+  int16_t raw[DEVICES];
+  uint8_t status[DEVICES];
+  int16_t temps[DEVICES];
+  for (uint8_t i = 0; i < DEVICES; i++) {
+    temps[i] = 128 * 21 + 64;
+  }
+  convert(temps);
+  before = bitsRead();
+  CHECK(dallas.getTemp(addresses[device]) == 128 * 21 + 64);
+  CHECK(bitsRead() - before == SHORT_BITS);
+
+  // -0.0625 C reads all ones like a missing device: confirmed by the full
+  // scratchpad, not a read error
+  temps[device] = -8;
+  convert(temps);
+  before = bitsRead();
+  CHECK(dallas.getTemp(addresses[device]) == -8);
+  CHECK(bitsRead() - before == SHORT_BITS + FULL_BITS);
+  before = bitsRead();
+  CHECK(dallas.readAllResults(raw, status, DEVICES) == DEVICES);
+  CHECK(bitsRead() - before ==
+        (DEVICES - 1) * SHORT_BITS + FULL_BITS + FULL_BITS);
+  for (uint8_t i = 0; i < DEVICES; i++) {
+    CHECK(status[i] == DEVICE_READ_OK);
+    if (i != ds18s20) {
+      CHECK(raw[i] == temps[i]);
+    }
+  }
+
+  // below zero and out of the all ones pattern: short reads only
+  for (uint8_t i = 0; i < DEVICES; i++) {
+    temps[i] = -128 * 10;
+  }
+  convert(temps);
+  before = bitsRead();
+  CHECK(dallas.readAllResults(raw, status, DEVICES) == DEVICES);
+  CHECK(bitsRead() - before == (DEVICES - 1) * SHORT_BITS + FULL_BITS);
+  CHECK(raw[device] == -128 * 10);
+
+  // a missing device reads all ones while the others answer the resets: not
+  // taken for -0.0625 C
+  sim.setConnected(simIndex[device], false);
+  CHECK(dallas.getTemp(addresses[device]) == DEVICE_DISCONNECTED_RAW);
+  CHECK(dallas.readAllResults(raw, status, DEVICES) == DEVICES - 1);
+  CHECK(status[device] == DEVICE_READ_CRC_ERROR);
+  CHECK(raw[device] == DEVICE_DISCONNECTED_RAW);
+  return TEST_RESULT();
+}
@@ -0,0 +1,159 @@
+#include <mgos.h>
+#include "Dallas.h"
+#include "SimulatedOnewire.h"
+#include "mgos_stub.h"
+#include "test.h"
+
+/*
+ * Staged readout on a bus of mixed resolutions: every device must be read
+ * only after its own conversion time, with the temperature of the current
+ * conversion (not the 85 degrees C power-on value or the previous one).
+ */
+
+#define DEVICES 7
+#define POWER_ON_RAW (85 * 128)
+
+static const uint8_t families[DEVICES] = {0x28, 0x28, 0x22, 0x28,
+                                          0x10, 0x3B, 0x42};
+static const uint8_t resolutions[DEVICES] = {9, 10, 11, 12, 12, 9, 11};
+
+typedef struct {
+  Dallas *dallas;
+  int16_t raw[DEVICES];
+  uint8_t status[DEVICES];
+  uint64_t start;
+  uint64_t readAt[DEVICES];
+  uint8_t stages;
+} Cycle;
+
+static void stageCb(Dallas *dallas, uint8_t resolution, void *arg) {
+  (void) resolution;
+  Cycle *cycle = (Cycle *) arg;
+  cycle->stages++;
+  for (uint8_t i = 0; i < dallas->getDeviceCount(); i++) {
+    if (cycle->readAt[i] == 0 && cycle->status[i] != 0xFF) {
+      cycle->readAt[i] = mgos_stub_micros() - cycle->start;
+    }
+  }
+}
+
+/*
+ * sim index of the device at Dallas index i
+ */
+static int simIndex(SimulatedOnewire *sim, Dallas *dallas, uint8_t i) {
+  uint8_t address[8];
+  dallas->getAddress(address, i);
+  for (int j = 0; j < sim->getDeviceCount(); j++) {
+    if (memcmp(sim->getRom(j), address, 8) == 0) {
+      return j;
+    }
+  }
+  return -1;
+}
+
+static void runCycle(SimulatedOnewire *sim, Dallas *dallas, int16_t base,
+                     uint8_t expectedStages) {
+  for (int j = 0; j < DEVICES; j++) {
+    sim->setTemperature(j, 128 * (base + 3 * j));
+  }
+
+  Cycle cycle;
+  memset(&cycle, 0, sizeof(cycle));
+  memset(cycle.status, 0xFF, sizeof(cycle.status));
+  cycle.dallas = dallas;
+  cycle.start = mgos_stub_micros();
+  CHECK(dallas->readAllStagedAsync(cycle.raw, cycle.status, DEVICES, stageCb,
+                                   &cycle));
+  mgos_stub_run_timers();
+  CHECK(!dallas->isConversionPending());
+  CHECK(cycle.stages == expectedStages);
+
+  uint8_t highest = 0;
+  for (uint8_t i = 0; i < DEVICES; i++) {
+    uint8_t address[8];
+    dallas->getAddress(address, i);
+    highest = MAX(highest, dallas->getResolution(address));
+  }
+
+  for (uint8_t i = 0; i < DEVICES; i++) {
+    uint8_t address[8];
+    dallas->getAddress(address, i);
+    uint8_t resolution = dallas->isParasitePowerMode()
+                             ? highest
+                             : dallas->getResolution(address);
+    int j = simIndex(sim, dallas, i);
+    CHECK(j >= 0);
+    CHECK(cycle.status[i] == DEVICE_READ_OK);
+    // the extended DS18S20 value is within 1/8 degree C
+    int16_t error = cycle.raw[i] - 128 * (base + 3 * j);
+    CHECK(error == 0 || (sim->getRom(j)[0] == 0x10 && abs(error) <= 16));
+    CHECK(cycle.raw[i] != POWER_ON_RAW);
+    CHECK(cycle.readAt[i] >=
+          1000 * (uint64_t) dallas->millisToWaitForConversion(resolution));
+  }
+}
+
+static void testStaged(bool parasite, bool checkForConversion) {
+  SimulatedOnewire sim(DEVICES);
+  sim.setClock(mgos_stub_micros, mgos_stub_advance);
+  for (int j = 0; j < DEVICES; j++) {
+    sim.addDevice(families[j], 0x100 + j, resolutions[j], parasite);
+  }
+
+  Dallas dallas;
+  dallas.setOneWire(&sim);
+  dallas.setCheckForConversion(checkForConversion);
+  dallas.begin();
+  CHECK(dallas.getDeviceCount() == DEVICES);
+  CHECK(dallas.isParasitePowerMode() == parasite);
+
+  // a callback per resolution, in parasite power mode all after the longest
+  // conversion time
+  runCycle(&sim, &dallas, 20, 4);
+  // the scratchpads now hold the first cycle: a stale read would show it
+  runCycle(&sim, &dallas, -10, 4);
+}
+
+static void failCb(Dallas *dallas, uint8_t resolution, void *arg) {
+  (void) dallas;
+  (void) resolution;
+  (void) arg;
+  CHECK(false);
+}
+
+/*
+ * with nothing to read no conversion is started and no state is kept for the
+ * next call
+ */
+static void testNothingToRead(void) {
+  SimulatedOnewire sim(DEVICES);
+  sim.setClock(mgos_stub_micros, mgos_stub_advance);
+  Dallas dallas;
+  dallas.setOneWire(&sim);
+  dallas.begin();
+  CHECK(dallas.getDeviceCount() == 0);
+  int16_t raw[DEVICES];
+  uint8_t status[DEVICES];
+  sim.resetStats();
+  CHECK(!dallas.readAllStagedAsync(raw, status, DEVICES, failCb, NULL));
+  CHECK(sim.getStats().resets == 0);
+  CHECK(!dallas.isConversionPending());
+
+  for (int j = 0; j < DEVICES; j++) {
+    sim.addDevice(families[j], 0x100 + j, resolutions[j]);
+  }
+  dallas.begin();
+  sim.resetStats();
+  CHECK(!dallas.readAllStagedAsync(raw, status, 0, failCb, NULL));
+  CHECK(sim.getStats().resets == 0);
+  CHECK(!dallas.isConversionPending());
+  runCycle(&sim, &dallas, 15, 4);
+}
+
+int main(void) {
+  testNothingToRead();
+  testStaged(false, true);
+  testStaged(false, false);
+  testStaged(true, true);
+  return TEST_RESULT();
+}
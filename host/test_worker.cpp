@@ -0,0 +1,212 @@
+#include <mgos.h>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include "DallasBusWorker.h"
+#include "SimulatedOnewire.h"
+#include "test.h"
+
+/*
+ * Several threads hammer one worker with conversion, read and rescan
+ * requests. Every accepted request must get its callback, at the latest when
+ * the worker is deleted, and concurrent conversion requests must share
+ * conversions.
+ */
+
+#define DEVICES 3
+#define THREADS 4
+#define ROUNDS 6
+
+/*
+ * counts the Convert T commands sent to all devices
+ */
+class CountingOnewire : public SimulatedOnewire {
+ public:
+  CountingOnewire() : SimulatedOnewire(DEVICES), conversions(0), _skip(false) {
+  }
+
+  virtual void skip(void) {
+    _skip = true;
+    SimulatedOnewire::skip();
+  }
+
+  virtual void write(uint8_t v, uint8_t power = 0) {
+    if (_skip && v == 0x44) {
+      conversions++;
+    }
+    _skip = false;
+    SimulatedOnewire::write(v, power);
+  }
+
+  uint32_t conversions;
+
+ private:
+  bool _skip;
+};
+
+typedef struct {
+  int16_t raw[DEVICES];
+  uint8_t status[DEVICES];
+} ReadAllResult;
+
+// by Dallas index, the device table is only touched by the worker task
+static uint8_t addresses[DEVICES][8];
+static int16_t expected[DEVICES];
+static std::atomic<int> accepted(0);
+static std::atomic<int> completed(0);
+static std::atomic<int> converts(0);
+static std::atomic<int> wrong(0);
+
+static uint64_t realMicros(void) {
+  static const std::chrono::steady_clock::time_point start =
+      std::chrono::steady_clock::now();
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+             std::chrono::steady_clock::now() - start)
+      .count();
+}
+
+/*
+ * the simulated bus takes real time, so the conversions end when the ticks
+ * of the worker say so; at most 500 us ahead, less than the rounding of the
+ * datasheet conversion times
+ */
+static void realAdvance(uint64_t micros) {
+  static uint64_t ahead = 0;
+  ahead += micros;
+  if (ahead >= 500) {
+    std::this_thread::sleep_for(std::chrono::microseconds(ahead));
+    ahead = 0;
+  }
+}
+
+static void doneCb(DallasBusWorker *worker, uint8_t type, int32_t result,
+                   void *arg) {
+  (void) worker;
+  switch (type) {
+    case DALLAS_REQUEST_CONVERT:
+      if (result != 1) {
+        wrong++;
+      }
+      break;
+    case DALLAS_REQUEST_READ:
+      if (result != expected[(intptr_t) arg]) {
+        wrong++;
+      }
+      break;
+    case DALLAS_REQUEST_READ_ALL: {
+      ReadAllResult *all = (ReadAllResult *) arg;
+      if (result != DEVICES) {
+        wrong++;
+      }
+      for (int i = 0; i < DEVICES; i++) {
+        if (all->status[i] != DEVICE_READ_OK || all->raw[i] != expected[i]) {
+          wrong++;
+        }
+      }
+      delete all;
+      break;
+    }
+    case DALLAS_REQUEST_RESCAN:
+      if (result != 0) {
+        wrong++;
+      }
+      break;
+  }
+  completed++;
+}
+
+/*
+ * retries while the queue is full
+ */
+template <typename Submit>
+static void submit(Submit request) {
+  while (!request()) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  accepted++;
+}
+
+static void hammer(DallasBusWorker *worker, int id) {
+  for (int round = 0; round < ROUNDS; round++) {
+    uint8_t index = (id + round) % DEVICES;
+    submit([=] {
+      return worker->read(addresses[index], doneCb, (void *) (intptr_t) index);
+    });
+
+    ReadAllResult *all = new ReadAllResult;
+    submit([=] {
+      return worker->readAll(all->raw, all->status, DEVICES, doneCb, all);
+    });
+    if (round % 3 == id % 3) {
+      submit([=] { return worker->rescan(doneCb, NULL); });
+    }
+
+    // the second conversion request arrives while the first one runs
+    submit([=] { return worker->convert(doneCb, NULL); });
+    converts++;
+    DallasBusWorker::Future future;
+    DallasBusWorker::initFuture(&future);
+    submit([&] { return worker->convert(DallasBusWorker::futureCb, &future); });
+    converts++;
+    if (DallasBusWorker::waitFuture(&future) != 1) {
+      wrong++;
+    }
+    completed++;
+  }
+}
+
+int main(void) {
+  CountingOnewire sim;
+  sim.setClock(realMicros, realAdvance);
+  for (int j = 0; j < DEVICES; j++) {
+    sim.addDevice(0x28, 0x300 + j, 9);
+    sim.setTemperature(j, 128 * (20 + j));
+  }
+
+  Dallas dallas;
+  dallas.setOneWire(&sim);
+  dallas.begin();
+  CHECK(dallas.getDeviceCount() == DEVICES);
+  for (uint8_t i = 0; i < DEVICES; i++) {
+    dallas.getAddress(addresses[i], i);
+    expected[i] = 128 * (20 + addresses[i][1]);  // serial 0x300 + j
+  }
+
+  DallasBusWorker *worker = new DallasBusWorker(&dallas);
+  CHECK(worker->begin());
+  // replace the power-on scratchpads before the reads start
+  DallasBusWorker::Future future;
+  DallasBusWorker::initFuture(&future);
+  CHECK(worker->convert(DallasBusWorker::futureCb, &future));
+  CHECK(DallasBusWorker::waitFuture(&future) == 1);
+  uint32_t first = sim.conversions;
+
+  std::vector<std::thread> threads;
+  for (int id = 0; id < THREADS; id++) {
+    threads.push_back(std::thread(hammer, worker, id));
+  }
+  for (size_t i = 0; i < threads.size(); i++) {
+    threads[i].join();
+  }
+
+  // requests still queued are served before the worker task exits, the
+  // reads after the conversion
+  submit([=] { return worker->convert(doneCb, NULL); });
+  for (int i = 0; i < DEVICES; i++) {
+    submit([=] {
+      return worker->read(addresses[i], doneCb, (void *) (intptr_t) i);
+    });
+  }
+  delete worker;
+
+  uint32_t conversions = sim.conversions - first - 1;  // not the last one
+  CHECK(completed == accepted);
+  CHECK(wrong == 0);
+  CHECK(converts == 2 * THREADS * ROUNDS);
+  CHECK(conversions > 0);
+  CHECK(conversions < (uint32_t) converts);
+  printf("requests %d, conversion requests %d, conversions %u\n",
+         accepted.load(), converts.load(), conversions);
+  return TEST_RESULT();
+}
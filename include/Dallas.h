@@ -1,11 +1,72 @@
 #pragma once
+#include <stddef.h>
 #include <stdint.h>
 #include "dallas_defines.h"
 
 class OnewireInterface;
+class OwTransaction;
+class DallasSampleStore;
 
 class Dallas {
  public:
+  /*
+   * Cached information about an enumerated device
+   */
+  typedef struct {
+    uint8_t address[8];
+    uint8_t family;
+    uint8_t resolution;
+    bool parasite;       // valid if parasiteKnown, see isParasite()
+    bool parasiteKnown;  // else only the bus wide mode is known
+    bool overdrive;  // addressed at overdrive speed
+    uint8_t overdriveFailures;  // consecutive reads failing at overdrive only
+    /*
+     * Registers of the last validated scratchpad read
+     */
+    bool scratchPadValid;
+    uint8_t highAlarm;
+    uint8_t lowAlarm;
+    uint8_t configuration;
+    /*
+     * Read errors and quarantine, see setQuarantineThreshold()
+     */
+    uint16_t crcErrors;
+    uint16_t presenceErrors;
+    uint8_t consecutiveErrors;
+    uint8_t quarantineSkips;  // reads skipped before the next retry
+    /*
+     * Last reported temperature, see setChangeReporting()
+     */
+    bool reported;
+    int16_t reportedRaw;
+    uint32_t reportedTime;  // milliseconds since boot
+  } DeviceInfo;
+
+  /*
+   * Called when an asynchronous conversion is complete and the results can be
+   * read
+   */
+  typedef void (*ConversionCallback)(Dallas *dallas, void *arg);
+
+  /*
+   * Called by readAllStagedAsync() when the devices with the given resolution
+   * have been read
+   */
+  typedef void (*StageCallback)(Dallas *dallas, uint8_t resolution, void *arg);
+
+  /*
+   * Called by rescan() for every device added to or removed from the bus
+   */
+  typedef void (*DeviceChangeCallback)(Dallas *dallas,
+                                       const uint8_t *deviceAddress, bool added,
+                                       void *arg);
+
+  /*
+   * Called for a temperature reported by setChangeReporting()
+   */
+  typedef void (*ChangeCallback)(Dallas *dallas, const uint8_t *deviceAddress,
+                                 int16_t raw, void *arg);
+
   Dallas();
 
   virtual ~Dallas();
@@ -13,10 +74,55 @@ class Dallas {
   void setOneWire(OnewireInterface *ow);
 
   /*
-   * Initialises the bus
+   * Initialises the bus.
+   * Only the devices of the supported families (see validFamily()) are
+   * enumerated.
    */
   void begin(void);
 
+  /*
+   * Searches the bus again and rebuilds the device table.
+   * Returns the number of devices found.
+   */
+  uint8_t refreshDeviceTable(void);
+
+  /*
+   * Searches the bus and updates the device table incrementally: the power
+   * mode and resolution are read only for new devices, the devices not found
+   * any more are removed. cb (may be NULL) is called for every change after
+   * the search is complete. The order of the remaining devices is kept, new
+   * devices are appended.
+   * Pointers returned by getDeviceInfo() are invalid after a change.
+   * Returns the number of changes.
+   */
+  uint16_t rescan(DeviceChangeCallback cb, void *arg);
+
+  /*
+   * Writes the device table (addresses, resolutions and power modes) to the
+   * file at path.
+   * Returns false if the file could not be written.
+   */
+  bool saveInventory(const char *path);
+
+  /*
+   * Builds the device table from the file written by saveInventory() instead
+   * of searching the bus. The inventory is checked with a presence pulse and
+   * a scratchpad read of up to samples devices spread over the table; the
+   * table is left empty if a check fails. Devices added to the bus since the
+   * save are not found, see rescan().
+   * Returns false if the file is missing or corrupt or a check failed.
+   */
+  bool loadInventory(const char *path,
+                     uint8_t samples = DALLAS_INVENTORY_SAMPLES);
+
+  /*
+   * Initialises the bus from the inventory at path, see loadInventory().
+   * If it cannot be used the bus is searched like begin() and the inventory
+   * is saved again.
+   * Returns true if the inventory was used.
+   */
+  bool begin(const char *inventoryPath);
+
   /*
    *  Returns the number of devices found on the bus
    */
@@ -35,7 +141,14 @@ class Dallas {
   bool validFamily(const uint8_t *deviceAddress);
 
   /*
-   * Finds an address at a given index on the bus
+   * Returns the cached information of the device at index or NULL
+   */
+  const DeviceInfo *getDeviceInfo(uint8_t index) {
+    return (index < _devices) ? &_deviceTable[index] : NULL;
+  }
+
+  /*
+   * Finds an address at a given index on the bus (from the device table)
    */
   bool getAddress(uint8_t *deviceAddress, uint8_t index);
 
@@ -63,10 +176,24 @@ class Dallas {
   void writeScratchPad(const uint8_t *, const uint8_t *);
 
   /*
-   * Reads device's power requirements
+   * Forgets the cached scratchpad registers of all devices, e.g. after they
+   * were changed by another bus master
+   */
+  void invalidateScratchPadCache(void);
+
+  /*
+   * Reads device's power requirements, or with deviceAddress NULL whether any
+   * device on the bus needs parasite power
    */
   bool readPowerSupply(const uint8_t *deviceAddress);
 
+  /*
+   * Returns true if the device needs parasite power. The enumeration only
+   * checks the whole bus, the device is probed on the first call if a device
+   * on the bus needs parasite power.
+   */
+  bool isParasite(const uint8_t *deviceAddress);
+
   /*
    * Gets the global resolution
    */
@@ -83,12 +210,62 @@ class Dallas {
    */
   void setResolution(uint8_t);
 
+  /*
+   * Sets the resolution of all devices to 9, 10, 11, or 12 bits, with one
+   * Skip ROM write when the alarm registers of all devices are cached and
+   * equal, else with one write per configurable device.
+   * copyToEeprom: also copies the registers of all devices to their EEPROM
+   * verify: reads every device back afterwards
+   * Returns false if a device read back failed or kept another resolution.
+   */
+  bool setResolution(uint8_t newResolution, bool copyToEeprom, bool verify);
+
   /*
    * Sets the resolution of a device to 9, 10, 11, or 12 bits
    */
   bool setResolution(const uint8_t *, uint8_t,
                      bool skipGlobalBitResolutionCalculation = false);
 
+  /*
+   * Gets the alarm thresholds (TH, TL) of a device in degrees C
+   * Returns false if the device is not connected
+   */
+  bool getAlarmThresholds(const uint8_t *deviceAddress, int8_t *low,
+                          int8_t *high);
+
+  /*
+   * Sets the alarm thresholds (TH, TL) of all devices in degrees C.
+   * Uses one broadcast write when all the devices have the same
+   * configuration register.
+   */
+  void setAlarmThresholds(int8_t low, int8_t high);
+
+  /*
+   * Sets the alarm thresholds (TH, TL) of a device in degrees C.
+   * Returns false if the device is not connected
+   */
+  bool setAlarmThresholds(const uint8_t *deviceAddress, int8_t low,
+                          int8_t high);
+
+  /*
+   * Restarts the alarm search
+   */
+  void resetAlarmSearch(void);
+
+  /*
+   * Finds the next device with an alarm condition (temperature of the last
+   * conversion >= TH or <= TL).
+   * Returns false when there are no more devices.
+   */
+  bool alarmSearch(uint8_t *deviceAddress);
+
+  /*
+   * Runs a complete alarm search and stores the device table indexes of the
+   * devices with an alarm condition in indexes (at most n).
+   * Returns the number of devices with an alarm condition.
+   */
+  uint8_t getAlarmDevices(uint8_t *indexes, uint8_t n);
+
   /*
    * Sets/gets the value of the waitForConversion flag
    * true : function requestTemperature() etc returns when conversion is ready
@@ -96,6 +273,7 @@ class Dallas {
    * CARE!!)
    *        (1) programmer has to check if the needed delay has passed
    *        (2) but the application can do meaningful things in that time
+   * See also requestTemperaturesAsync()
    */
   void setWaitForConversion(bool value) {
     _waitForConversion = value;
@@ -121,12 +299,145 @@ class Dallas {
     return _checkForConversion;
   }
 
+  /*
+   * Sets/gets the overdrive flag
+   * true : devices supporting it (DS28EA00) are addressed and read at overdrive
+   * speed if the OnewireInterface backend supports it. A read failing at
+   * overdrive speed is retried at standard speed; a device whose reads fail
+   * at overdrive speed only, several times in a row, falls back to standard
+   * speed.
+   * false: standard speed only
+   */
+  void setOverdrive(bool value) {
+    _overdrive = value;
+  }
+
+  bool getOverdrive(void) {
+    return _overdrive;
+  }
+
+  /*
+   * Sets/gets the shortRead flag
+   * true : getTemp() etc and readAll() etc read only the 2 temperature bytes
+   * of the scratchpad. A value failing the plausibility checks (power-on
+   * value, out of range) or reading all ones, as a missing device and a valid
+   * -0.0625 C do, is read again with the full scratchpad and its CRC.
+   * DS18S20 devices are always read in full for the extended resolution.
+   * false: the full scratchpad is read and checked by CRC
+   */
+  void setShortRead(bool value) {
+    _shortRead = value;
+  }
+
+  bool getShortRead(void) {
+    return _shortRead;
+  }
+
+  /*
+   * Sets/gets the quarantine threshold
+   * n > 0: a device failing n consecutive temperature reads is quarantined,
+   * its next reads are skipped (DEVICE_READ_QUARANTINED, DEVICE_DISCONNECTED_*)
+   * and it is retried after 1, 2, 4, ... up to 64 skipped reads while it keeps
+   * failing. A successful read ends the quarantine.
+   * 0: no quarantine (default)
+   * The read errors are counted in the device table regardless, see
+   * getDeviceInfo().
+   */
+  void setQuarantineThreshold(uint8_t n) {
+    _quarantineThreshold = n;
+  }
+
+  uint8_t getQuarantineThreshold(void) {
+    return _quarantineThreshold;
+  }
+
+  /*
+   * Attaches a sample store (NULL detaches it) recording the temperatures of
+   * the device table read successfully by getTemp() etc and the readAll*()
+   * functions.
+   * The store is not owned by Dallas and may be shared by several buses.
+   */
+  void setSampleStore(DallasSampleStore *store) {
+    _sampleStore = store;
+  }
+
+  DallasSampleStore *getSampleStore(void) {
+    return _sampleStore;
+  }
+
+  /*
+   * Reports the temperatures of the device table read successfully by
+   * getTemp() etc and the readAll*() functions to cb (NULL stops reporting)
+   * only when they move more than deadband (raw, 1/128 degrees C) away from
+   * the last value reported for the device, or when maxSilence milliseconds
+   * (0: no limit) have passed since that report. The first value of every
+   * device is reported.
+   */
+  void setChangeReporting(uint16_t deadband, uint32_t maxSilence,
+                          ChangeCallback cb, void *arg);
+
+  /*
+   * Returns true if the device at index is in quarantine
+   */
+  bool isQuarantined(uint8_t index);
+
+  /*
+   * Clears the read errors of all devices and ends their quarantine
+   */
+  void resetDeviceErrors(void);
+
   /*
    * Sends command for all devices on the bus to perform a temperature
    * conversion
    */
   void requestTemperatures(void);
 
+  /*
+   * Sends the convert command to all devices on the bus and returns
+   * immediately, regardless of the waitForConversion flag
+   */
+  void startConversion(void);
+
+  /*
+   * Sends command for all devices on the bus to perform a temperature
+   * conversion and returns immediately.
+   * The completion is checked from a mgos timer and cb is called when the
+   * results can be read.
+   * Returns false if a conversion is already pending or the timer could not be
+   * set.
+   */
+  bool requestTemperaturesAsync(ConversionCallback cb, void *arg);
+
+  /*
+   * Sends command for all devices on the bus to perform a temperature
+   * conversion and returns immediately.
+   * The devices are then read in groups of equal resolution, each group as
+   * soon as its datasheet conversion time has elapsed (all of them with the
+   * first group, if the bus reports then that every conversion is complete).
+   * In parasite power mode all groups are read after the conversion time of
+   * the highest resolution. raw and status are filled as in readAllResults()
+   * and cb is called after each group.
+   * raw and status must stay valid until the last group (the highest
+   * resolution on the bus) has been read.
+   * Returns false without starting a conversion if one is already pending or
+   * there is no device to read (n or the device count is 0), else false if
+   * the timer could not be set.
+   */
+  bool readAllStagedAsync(int16_t *raw, uint8_t *status, uint8_t n,
+                          StageCallback cb, void *arg);
+
+  /*
+   * Returns true if an asynchronous conversion is pending
+   */
+  bool isConversionPending(void) {
+    return _conversionTimer != 0;
+  }
+
+  /*
+   * Cancels the pending asynchronous conversion. The callback is not called.
+   */
+  void cancelConversion(void);
+
   /*
    * Sends command for one device to perform a temperature conversion by address
    */
@@ -142,6 +453,29 @@ class Dallas {
    */
   int16_t getTemp(const uint8_t *);
 
+  /*
+   * Converts and reads all the devices in the device table in one pass:
+   * one broadcast conversion, one wait sized for the highest resolution, then
+   * one scratchpad sweep.
+   * Fills at most n entries of raw (DEVICE_DISCONNECTED_RAW on failure) and,
+   * if not NULL, of status (DEVICE_READ_*), in device table order.
+   * Returns the number of devices read successfully.
+   */
+  uint8_t readAll(int16_t *raw, uint8_t *status, uint8_t n);
+
+  /*
+   * Same as readAll() but without starting a conversion, e.g. after
+   * requestTemperaturesAsync() completed.
+   */
+  uint8_t readAllResults(int16_t *raw, uint8_t *status, uint8_t n);
+
+  /*
+   * Same as readAllResults() but only for the devices with the given
+   * resolution, the other entries of raw and status are left untouched.
+   */
+  uint8_t readResultsByResolution(uint8_t resolution, int16_t *raw,
+                                  uint8_t *status, uint8_t n);
+
   /*
    * Returns temperature in degrees C
    */
@@ -153,12 +487,12 @@ class Dallas {
   float getTempF(const uint8_t *);
 
   /*
-   * Get temperature for device index (slow)
+   * Get temperature for device index
    */
   float getTempCByIndex(uint8_t);
 
   /*
-   * Get temperature for device index (slow)
+   * Get temperature for device index
    */
   float getTempFByIndex(uint8_t);
 
@@ -176,6 +510,19 @@ class Dallas {
 
   int16_t millisToWaitForConversion(uint8_t);
 
+  /*
+   * Copies the bus statistics of op (DALLAS_OP_*) accumulated since the last
+   * resetBusStats().
+   * Returns false if op is out of range or the library was built without
+   * DALLAS_BUS_STATS.
+   */
+  bool getBusStats(uint8_t op, DallasBusStats *stats);
+
+  /*
+   * Clears the bus statistics of all operations
+   */
+  void resetBusStats(void);
+
   /*
    * Static utility functions
    */
@@ -199,6 +546,23 @@ class Dallas {
    */
   static float rawToFahrenheit(int16_t);
 
+  /*
+   * Convert from raw to 1/100 degrees C, 1/100 degrees F and 1/1000 degrees C
+   * with integer arithmetic, rounded to nearest (halves away from zero).
+   * Return DEVICE_DISCONNECTED_C * 100, DEVICE_DISCONNECTED_F * 100 and
+   * DEVICE_DISCONNECTED_C * 1000 for a disconnected raw value.
+   */
+  static int32_t rawToCentiCelsius(int16_t);
+  static int32_t rawToCentiFahrenheit(int16_t);
+  static int32_t rawToMilliCelsius(int16_t);
+
+  /*
+   * Convert n raw values, e.g. the results of readAll()
+   */
+  static void rawToCentiCelsius(const int16_t *raw, int32_t *out, uint8_t n);
+  static void rawToCentiFahrenheit(const int16_t *raw, int32_t *out, uint8_t n);
+  static void rawToMilliCelsius(const int16_t *raw, int32_t *out, uint8_t n);
+
   /*
    * Compute a Dallas Semiconductor 8 bit CRC, these are used in the
    * ROM and scratchpad registers.
@@ -213,6 +577,12 @@ class Dallas {
   typedef uint8_t ScratchPad[9];
   typedef uint8_t DeviceAddress[8];
 
+  /*
+   * Devices found by the last enumeration and the allocated size of the table
+   */
+  DeviceInfo *_deviceTable;
+  uint8_t _deviceTableSize;
+
   /*
    * Parasite power on or off
    */
@@ -227,6 +597,24 @@ class Dallas {
   bool _waitForConversion;
   bool _checkForConversion;
 
+  /*
+   * Overdrive allowed and the speed the bus currently runs at
+   */
+  bool _overdrive;
+  bool _overdriveActive;
+
+  bool _shortRead;
+  uint8_t _quarantineThreshold;
+  DallasSampleStore *_sampleStore;
+
+  /*
+   * Change reporting
+   */
+  ChangeCallback _changeCb;
+  void *_changeCbArg;
+  uint16_t _changeDeadband;
+  uint32_t _changeMaxSilence;
+
   /*
    * The OneWire object
    */
@@ -237,10 +625,176 @@ class Dallas {
    */
   bool _ownOnewire;
 
+  /*
+   * Asynchronous conversion state
+   */
+  uintptr_t _conversionTimer;
+  ConversionCallback _conversionCb;
+  void *_conversionCbArg;
+  uint64_t _conversionDeadline;
+
+  /*
+   * Staged readout state
+   */
+  StageCallback _stageCb;
+  int16_t *_stageRaw;
+  uint8_t *_stageStatus;
+  uint8_t _stageCount;
+  uint8_t _stageResolution;
+  bool _stagePoll;  // no scratchpad read since Convert T
+  uint64_t _conversionStart;
+
+#if DALLAS_BUS_STATS
+  /*
+   * Bus statistics per operation and the operation being executed
+   */
+  DallasBusStats _busStats[DALLAS_OP_COUNT];
+  uint8_t _busStatsOp;
+#endif
+
+  /*
+   * Bus primitives, appended to a transaction run by owRun() and counted when
+   * DALLAS_BUS_STATS is enabled
+   */
+  void owReset(OwTransaction &t);
+  void owSelect(OwTransaction &t, const uint8_t *deviceAddress);
+  void owSkip(OwTransaction &t);
+  void owOverdriveSkip(OwTransaction &t);
+  void owWrite(OwTransaction &t, uint8_t v, uint8_t power = 0);
+  void owReadBytes(OwTransaction &t, uint8_t *buf, uint16_t count);
+  void owReadBit(OwTransaction &t, uint8_t *bit);
+  bool owRun(OwTransaction &t);
+  uint8_t owSearch(uint8_t *deviceAddress, bool searchMode = true);
+
   /*
    * Reads scratchpad and returns the raw temperature
    */
   int16_t calculateTemperature(const uint8_t *, uint8_t *);
 
+  /*
+   * Reads the scratchpad without the final reset and stores the raw
+   * temperature (DEVICE_DISCONNECTED_RAW on failure).
+   * Returns DEVICE_READ_*
+   */
+  uint8_t readTemperature(DeviceInfo *info, int16_t *raw);
+
+  /*
+   * Reads the 9 bytes of the scratchpad, optionally followed by a reset.
+   * Returns false if the first reset finds no device
+   */
+  bool readScratchPadBytes(const uint8_t *deviceAddress, uint8_t *scratchPad,
+                           bool reset);
+
+  /*
+   * Reads the scratchpad and checks its CRC. A read failing at overdrive
+   * speed is retried at standard speed, see OVERDRIVE_MAX_FAILURES.
+   * Returns DEVICE_READ_OK, DEVICE_READ_NO_PRESENCE or DEVICE_READ_CRC_ERROR
+   */
+  uint8_t readValidScratchPad(DeviceInfo *info, const uint8_t *deviceAddress,
+                              uint8_t *scratchPad, bool reset);
+
+  /*
+   * Returns true if the device is matched at overdrive speed
+   */
+  bool selectsOverdrive(const DeviceInfo *info);
+
+  /*
+   * Counts the result (DEVICE_READ_*) of a read of the device and updates its
+   * quarantine, info may be NULL. Returns status
+   */
+  uint8_t recordRead(DeviceInfo *info, uint8_t status);
+
+  /*
+   * Returns true if a read of the quarantined device must be skipped
+   */
+  bool skipQuarantined(DeviceInfo *info);
+
+  /*
+   * Returns the time of the samples of a read sweep
+   */
+  uint32_t sampleTime(void);
+
+  /*
+   * Records a temperature read successfully in the sample store and reports
+   * it if needed, info may be NULL
+   */
+  void recordSample(DeviceInfo *info, uint32_t now, int16_t raw);
+
+  /*
+   * Reads the 2 temperature bytes of the scratchpad, optionally followed by a
+   * reset, and stores the raw temperature.
+   * Returns DEVICE_READ_OK, DEVICE_READ_NO_PRESENCE or DEVICE_READ_CRC_ERROR
+   * if the value is not plausible
+   */
+  uint8_t readTemperatureShort(const uint8_t *deviceAddress, int16_t *raw,
+                               bool reset);
+
+  /*
+   * Stores the registers of a validated scratchpad in the device table entry
+   */
+  void cacheScratchPad(DeviceInfo *info, const uint8_t *scratchPad);
+
+  /*
+   * Returns the resolution coded by a configuration register or 0
+   */
+  static uint8_t configurationToResolution(uint8_t configuration);
+
+  /*
+   * Returns the configuration register coding resolution, 9 bits if out of
+   * range
+   */
+  static uint8_t resolutionToConfiguration(uint8_t resolution);
+
+  /*
+   * Returns the device table entry of the address or NULL
+   */
+  DeviceInfo *findDevice(const uint8_t *deviceAddress);
+
+  /*
+   * Appends an entry to the device table, growing it if needed
+   */
+  DeviceInfo *addDevice(const uint8_t *deviceAddress);
+
+  /*
+   * Finds the next device of a supported family, *family must be 0 before the
+   * first call
+   * Returns false when there are no more devices
+   */
+  bool searchDevice(uint8_t *deviceAddress, uint8_t *family);
+
+  /*
+   * Recomputes the bus power mode and the global resolution from the device
+   * table, devices with an unknown power mode count as parasite powered
+   */
+  void updateBusInfo(void);
+
+  /*
+   * Checks with one broadcast whether any device needs parasite power, if
+   * none does the power mode of every device is known
+   */
+  void checkParasite(void);
+
+  /*
+   * Checks a loaded inventory against the bus: a presence pulse and the
+   * scratchpad of up to samples devices
+   */
+  bool verifyInventory(uint8_t samples);
+
   void blockTillConversionComplete(uint8_t);
+
+  static void conversionTimerCb(void *arg);
+
+  /*
+   * Returns the lowest resolution higher than resolution among the first
+   * _stageCount devices, or 0
+   */
+  uint8_t nextStageResolution(uint8_t resolution);
+
+  /*
+   * Arms the timer for the next group of the staged readout
+   * Returns false if there is no group left
+   */
+  bool scheduleStage(void);
+
+  static void stageTimerCb(void *arg);
 };
@@ -0,0 +1,121 @@
+#pragma once
+#include <stdint.h>
+#include "Dallas.h"
+
+// Maximum number of buses in a group
+#ifndef DALLAS_BUS_GROUP_SIZE
+#define DALLAS_BUS_GROUP_SIZE 8
+#endif
+
+/*
+ * Drives several 1-Wire buses, each with its own Dallas object, as one:
+ * the conversions are started on all buses at once and share one deadline,
+ * then the buses are read one after another. A cycle costs one conversion
+ * period plus the readout time instead of one conversion period per bus.
+ */
+class DallasBusGroup {
+ public:
+  /*
+   * Called when all the buses of the group have been read
+   */
+  typedef void (*ReadCallback)(DallasBusGroup *group, void *arg);
+
+  DallasBusGroup();
+
+  virtual ~DallasBusGroup();
+
+  /*
+   * Adds a bus (a Dallas object already initialised with begin()).
+   * The group does not take ownership.
+   * Returns false if the group is full.
+   */
+  bool addBus(Dallas *dallas);
+
+  uint8_t getBusCount(void) {
+    return _count;
+  }
+
+  /*
+   * Returns the bus at index or NULL
+   */
+  Dallas *getBus(uint8_t index) {
+    return (index < _count) ? _buses[index] : NULL;
+  }
+
+  /*
+   * Returns the number of devices of all the buses
+   */
+  uint16_t getDeviceCount(void);
+
+  /*
+   * Starts a conversion on all the buses and returns immediately
+   */
+  void startConversion(void);
+
+  /*
+   * Returns the number of milliseconds to wait for the slowest bus
+   */
+  uint16_t millisToWaitForConversion(void);
+
+  /*
+   * Converts and reads all the devices of all the buses: one conversion on
+   * all the buses at once, one wait, then one scratchpad sweep per bus.
+   * raw and status (may be NULL) are filled as in Dallas::readAll(), the
+   * devices of bus 0 first, then those of bus 1 and so on.
+   * Returns the number of devices read successfully.
+   */
+  uint16_t readAll(int16_t *raw, uint8_t *status, uint16_t n);
+
+  /*
+   * Same as readAll() but waits from a mgos timer and returns immediately.
+   * cb is called when all the buses have been read, raw and status must stay
+   * valid until then.
+   * Returns false if a read is already pending or the timer could not be set.
+   */
+  bool readAllAsync(int16_t *raw, uint8_t *status, uint16_t n,
+                    ReadCallback cb, void *arg);
+
+  /*
+   * Returns true if an asynchronous read is pending
+   */
+  bool isReadPending(void) {
+    return _timer != 0;
+  }
+
+  /*
+   * Cancels the pending asynchronous read. The callback is not called.
+   */
+  void cancelRead(void);
+
+ protected:
+  Dallas *_buses[DALLAS_BUS_GROUP_SIZE];
+  uint8_t _count;
+
+  /*
+   * Asynchronous read state
+   */
+  uintptr_t _timer;
+  ReadCallback _cb;
+  void *_cbArg;
+  int16_t *_raw;
+  uint8_t *_status;
+  uint16_t _n;
+  uint64_t _deadline;
+
+  /*
+   * Returns true if every bus can report the end of its conversions
+   */
+  bool canCheckForConversion(void);
+
+  /*
+   * Returns true if the conversions of all the buses are complete
+   */
+  bool isConversionComplete(void);
+
+  /*
+   * Reads the results of all the buses
+   */
+  uint16_t readAllResults(int16_t *raw, uint8_t *status, uint16_t n);
+
+  static void timerCb(void *arg);
+};
@@ -0,0 +1,145 @@
+#pragma once
+#include "dallas_defines.h"
+
+#if DALLAS_BUS_WORKER
+#include <stdint.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include <freertos/task.h>
+#include "Dallas.h"
+
+// Requests queued and conversion requests waiting for the running conversion
+#ifndef DALLAS_WORKER_QUEUE
+#define DALLAS_WORKER_QUEUE 8
+#endif
+
+/*
+ * Owns a bus for several FreeRTOS tasks: one worker task serves a bounded
+ * queue of requests and is the only one touching the Dallas object, so the
+ * bus transactions of different callers cannot interleave. Callers are not
+ * blocked while a conversion runs: conversion requests arriving meanwhile
+ * join the running one, the other requests are served when it is complete.
+ * The Dallas object must be initialised with begin() before and not be used
+ * directly once the worker is started.
+ */
+class DallasBusWorker {
+ public:
+  /*
+   * Called from the worker task when a request is done. result is
+   * - DALLAS_REQUEST_CONVERT: 1
+   * - DALLAS_REQUEST_READ: the raw temperature or DEVICE_DISCONNECTED_RAW
+   * - DALLAS_REQUEST_READ_ALL: the number of devices read successfully
+   * - DALLAS_REQUEST_RESCAN: the number of devices added or removed
+   * - DALLAS_REQUEST_SET_RESOLUTION: 1
+   */
+  typedef void (*RequestCallback)(DallasBusWorker *worker, uint8_t type,
+                                  int32_t result, void *arg);
+
+  /*
+   * A request result a task can block on, see initFuture()
+   */
+  typedef struct {
+    TaskHandle_t task;
+    int32_t result;
+  } Future;
+
+  DallasBusWorker(Dallas *dallas);
+
+  /*
+   * Stops the worker task: the requests queued before are served, then the
+   * calling task blocks until the worker task has exited. Must not be called
+   * from the worker task, i.e. from a request callback.
+   */
+  virtual ~DallasBusWorker();
+
+  /*
+   * Starts the worker task.
+   * Returns false if the task or the queue could not be created.
+   */
+  bool begin(uint32_t stackSize = 4096, UBaseType_t priority = 5);
+
+  Dallas *getDallas(void) {
+    return _dallas;
+  }
+
+  /*
+   * Queue a request, cb (may be NULL) is called when it is done.
+   * Returns false if the queue is full or the worker is not started.
+   */
+  bool convert(RequestCallback cb, void *arg);
+  bool read(const uint8_t *deviceAddress, RequestCallback cb, void *arg);
+
+  /*
+   * raw and status (may be NULL) are filled as in Dallas::readAllResults()
+   * and must stay valid until cb is called
+   */
+  bool readAll(int16_t *raw, uint8_t *status, uint8_t n, RequestCallback cb,
+               void *arg);
+  bool rescan(RequestCallback cb, void *arg);
+  bool setResolution(uint8_t resolution, RequestCallback cb, void *arg);
+
+  /*
+   * Binds future to the calling task. Pass futureCb and the future to a
+   * request, then block in waitFuture(). A task waits for one future at a
+   * time; the worker task must not wait at all.
+   */
+  static void initFuture(Future *future);
+  static void futureCb(DallasBusWorker *worker, uint8_t type, int32_t result,
+                       void *arg);
+
+  /*
+   * Blocks the calling task until the request is done and returns its result
+   */
+  static int32_t waitFuture(Future *future);
+
+ protected:
+  typedef struct {
+    uint8_t type;
+    uint8_t address[8];
+    uint8_t resolution;
+    int16_t *raw;
+    uint8_t *status;
+    uint8_t n;
+    RequestCallback cb;
+    void *arg;
+  } Request;
+
+  Dallas *_dallas;
+  QueueHandle_t _queue;
+  TaskHandle_t _task;
+
+  /*
+   * Running conversion and the conversion requests completed by it
+   */
+  bool _converting;
+  TickType_t _conversionStart;
+  TickType_t _conversionTicks;
+  Request _waiting[DALLAS_WORKER_QUEUE];
+  uint8_t _waitingCount;
+
+  bool submit(const Request *request);
+  void run(void);
+  void execute(const Request *request);
+  void startConversion(const Request *request);
+
+  /*
+   * Returns true if the running conversion is complete, with block true
+   * waits for it
+   */
+  bool waitConversion(bool block);
+
+  /*
+   * Calls the callbacks of the conversion requests waiting for it
+   */
+  void finishConversion(void);
+
+  bool canCheckConversion(void);
+
+  /*
+   * Returns the ticks until the running conversion is checked again
+   */
+  TickType_t nextCheck(void);
+
+  static void taskFn(void *arg);
+};
+#endif
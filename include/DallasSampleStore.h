@@ -0,0 +1,115 @@
+#pragma once
+#include <stdint.h>
+
+// Devices, samples kept per device and rollup windows of a store
+#ifndef DALLAS_SAMPLE_DEVICES
+#define DALLAS_SAMPLE_DEVICES 16
+#endif
+
+#ifndef DALLAS_SAMPLE_DEPTH
+#define DALLAS_SAMPLE_DEPTH 64
+#endif
+#if DALLAS_SAMPLE_DEPTH > 255
+#error DALLAS_SAMPLE_DEPTH must not exceed 255
+#endif
+
+#ifndef DALLAS_SAMPLE_WINDOWS
+#define DALLAS_SAMPLE_WINDOWS 2
+#endif
+
+/*
+ * Keeps the last DALLAS_SAMPLE_DEPTH raw temperatures of up to
+ * DALLAS_SAMPLE_DEVICES devices with their time, and min/max/mean/count
+ * rollups over up to DALLAS_SAMPLE_WINDOWS window lengths, updated as the
+ * samples are added. The memory is part of the store, sized at compile time.
+ * Attached to a Dallas object (see Dallas::setSampleStore()) it records the
+ * results of the readAll*() functions, so history and aggregates can be
+ * queried without bus traffic.
+ */
+class DallasSampleStore {
+ public:
+  typedef struct {
+    uint32_t time;  // milliseconds since boot
+    int16_t raw;
+  } Sample;
+
+  typedef struct {
+    uint32_t start;  // start of the window, milliseconds since boot
+    int16_t min;
+    int16_t max;
+    int16_t mean;  // rounded to nearest
+    uint16_t count;
+  } Rollup;
+
+  DallasSampleStore();
+
+  virtual ~DallasSampleStore();
+
+  /*
+   * Sets the length of rollup window index (< DALLAS_SAMPLE_WINDOWS) in
+   * milliseconds, 0 disables it. The windows are aligned to multiples of
+   * their length. Changing a length clears its rollups.
+   * Returns false if index is out of range.
+   */
+  bool setWindow(uint8_t index, uint32_t millis);
+
+  /*
+   * Adds a sample of the device, time in milliseconds since boot. A sample
+   * older than the start of a window being filled is counted in that window.
+   * Returns false if the store is full of other devices.
+   */
+  bool add(const uint8_t *deviceAddress, uint32_t time, int16_t raw);
+
+  /*
+   * Copies at most n samples of the device into samples, in the order they
+   * were added.
+   * Returns the number of samples copied.
+   */
+  uint8_t getSamples(const uint8_t *deviceAddress, Sample *samples,
+                     uint8_t n);
+
+  /*
+   * Returns the last sample of the device in sample, false if there is none
+   */
+  bool getLast(const uint8_t *deviceAddress, Sample *sample);
+
+  /*
+   * Returns the rollup of the last complete window (current = false) or of
+   * the window being filled (current = true) of length index.
+   * Returns false if the window has no samples.
+   */
+  bool getRollup(const uint8_t *deviceAddress, uint8_t index, bool current,
+                 Rollup *rollup);
+
+  /*
+   * Forgets the samples and rollups of the device, or of all devices if
+   * deviceAddress is NULL
+   */
+  void clear(const uint8_t *deviceAddress);
+
+ protected:
+  typedef struct {
+    uint32_t start;
+    int32_t sum;
+    int16_t min;
+    int16_t max;
+    uint16_t count;
+  } Accumulator;
+
+  typedef struct {
+    uint8_t address[8];
+    bool used;
+    uint8_t head;  // next sample written
+    uint8_t count;
+    uint32_t times[DALLAS_SAMPLE_DEPTH];
+    int16_t raws[DALLAS_SAMPLE_DEPTH];
+    Accumulator current[DALLAS_SAMPLE_WINDOWS];
+    Accumulator last[DALLAS_SAMPLE_WINDOWS];
+  } Series;
+
+  Series _series[DALLAS_SAMPLE_DEVICES];
+  uint32_t _windows[DALLAS_SAMPLE_WINDOWS];
+
+  Series *find(const uint8_t *deviceAddress, bool create);
+  static void toRollup(const Accumulator *acc, Rollup *rollup);
+};
@@ -1,6 +1,66 @@
 #pragma once
+#include <stdint.h>
+
+// Set to 1 to count the bus traffic of every Dallas operation
+#ifndef DALLAS_BUS_STATS
+#define DALLAS_BUS_STATS 0
+#endif
+
+// Set to 1 to build DallasBusWorker, needs FreeRTOS
+#ifndef DALLAS_BUS_WORKER
+#define DALLAS_BUS_WORKER 0
+#endif
+
+// Devices whose scratchpad is read to verify a loaded inventory
+#ifndef DALLAS_INVENTORY_SAMPLES
+#define DALLAS_INVENTORY_SAMPLES 4
+#endif
 
 // Error Codes
 #define DEVICE_DISCONNECTED_C -128
 #define DEVICE_DISCONNECTED_F -196
 #define DEVICE_DISCONNECTED_RAW -7040
+
+// Per device status codes of the bulk read functions
+#define DEVICE_READ_OK 0
+#define DEVICE_READ_NO_PRESENCE 1  // no presence pulse on reset
+#define DEVICE_READ_CRC_ERROR 2    // scratchpad CRC mismatch
+#define DEVICE_READ_QUARANTINED 3  // not read, device in quarantine
+
+// Operations the bus statistics are attributed to
+#define DALLAS_OP_OTHER 0
+#define DALLAS_OP_BEGIN 1
+#define DALLAS_OP_IS_CONNECTED 2
+#define DALLAS_OP_READ_SCRATCHPAD 3
+#define DALLAS_OP_WRITE_SCRATCHPAD 4
+#define DALLAS_OP_READ_POWER_SUPPLY 5
+#define DALLAS_OP_GET_RESOLUTION 6
+#define DALLAS_OP_SET_RESOLUTION 7
+#define DALLAS_OP_REQUEST_TEMPERATURES 8
+#define DALLAS_OP_CONVERSION_CHECK 9
+#define DALLAS_OP_GET_TEMP 10
+#define DALLAS_OP_READ_ALL 11
+#define DALLAS_OP_SET_ALARM 12
+#define DALLAS_OP_ALARM_SEARCH 13
+#define DALLAS_OP_RESCAN 14
+#define DALLAS_OP_COUNT 15
+
+// Requests served by DallasBusWorker
+#define DALLAS_REQUEST_CONVERT 0         // converts all devices
+#define DALLAS_REQUEST_READ 1            // reads one device
+#define DALLAS_REQUEST_READ_ALL 2        // reads the last conversion results
+#define DALLAS_REQUEST_RESCAN 3          // updates the device table
+#define DALLAS_REQUEST_SET_RESOLUTION 4  // sets the resolution of all devices
+
+// Bus traffic of an operation, bus time estimated with standard speed timings
+typedef struct {
+  uint32_t calls;
+  uint32_t resets;
+  uint32_t selects;
+  uint32_t searches;
+  uint32_t bytesWritten;
+  uint32_t bytesRead;
+  uint32_t bitsWritten;
+  uint32_t bitsRead;
+  uint32_t busMicros;
+} DallasBusStats;
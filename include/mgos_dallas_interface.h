@@ -2,8 +2,14 @@
 
 #ifdef __cplusplus
 #include "Dallas.h"
+#include "DallasBusGroup.h"
+#include "DallasBusWorker.h"
+#include "DallasSampleStore.h"
 #else
 typedef struct DallasTag Dallas;
+typedef struct DallasBusGroupTag DallasBusGroup;
+typedef struct DallasBusWorkerTag DallasBusWorker;
+typedef struct DallasSampleStoreTag DallasSampleStore;
 #include <stdint.h>
 #include "dallas_defines.h"
 #endif
@@ -12,6 +18,31 @@ typedef struct DallasTag Dallas;
 extern "C" {
 #endif
 
+/*
+ * Called when an asynchronous conversion is complete.
+ */
+typedef void (*mgos_dallas_conversion_cb_t)(Dallas *dt, void *arg);
+
+/*
+ * Called by mgos_dallas_rescan() for every device added to (`added` true) or
+ * removed from the bus.
+ */
+typedef void (*mgos_dallas_device_change_cb_t)(Dallas *dt, const uint8_t *addr,
+                                               bool added, void *arg);
+
+/*
+ * Called for a temperature reported by mgos_dallas_set_change_reporting().
+ */
+typedef void (*mgos_dallas_change_cb_t)(Dallas *dt, const uint8_t *addr,
+                                        int16_t raw, void *arg);
+
+/*
+ * Called by mgos_dallas_read_all_staged_async() after the devices with
+ * `resolution` have been read.
+ */
+typedef void (*mgos_dallas_stage_cb_t)(Dallas *dt, uint8_t resolution,
+                                       void *arg);
+
 /*
  * Initializes the mgos_dallas_ driver with a GPIO `pin`
  * Return value: handle opaque pointer.
@@ -29,6 +60,45 @@ void mgos_dallas_close(Dallas *dt);
  */
 void mgos_dallas_begin(Dallas *dt);
 
+/*
+ * Searches the bus again and rebuilds the device table.
+ * Returns the number of devices found or 0 if an operation failed.
+ */
+int mgos_dallas_refresh_device_table(Dallas *dt);
+
+/*
+ * Searches the bus and updates the device table incrementally, querying only
+ * the new devices. `cb` (may be NULL) is called for every added or removed
+ * device.
+ * Returns the number of changes or 0 if an operation failed.
+ */
+int mgos_dallas_rescan(Dallas *dt, mgos_dallas_device_change_cb_t cb,
+                       void *arg);
+
+/*
+ * Writes the device table (addresses, resolutions and power modes) to the
+ * file at `path`.
+ * Returns false if the file could not be written or an operaiton failed.
+ */
+bool mgos_dallas_save_inventory(Dallas *dt, const char *path);
+
+/*
+ * Builds the device table from the file written by
+ * mgos_dallas_save_inventory() instead of searching the bus, checked with a
+ * presence pulse and a scratchpad read of up to `samples` devices.
+ * Returns false if the file is missing or corrupt, a check failed or an
+ * operaiton failed.
+ */
+bool mgos_dallas_load_inventory(Dallas *dt, const char *path, int samples);
+
+/*
+ * Initialises the 1-Wire bus from the inventory at `path`. If it cannot be
+ * used the bus is searched like mgos_dallas_begin() and the inventory is
+ * saved again.
+ * Returns true if the inventory was used.
+ */
+bool mgos_dallas_begin_with_inventory(Dallas *dt, const char *path);
+
 /*
  * Returns the number of devices found on the bus.
  * Return always 0 if an operaiton failed.
@@ -85,12 +155,24 @@ void mgos_dallas_write_scratch_pad(Dallas *dt, const uint8_t *addr,
                                    const uint8_t *sp);
 
 /*
- * Read device's power requirements.
- * Return true if device needs parasite power.
+ * Forgets the cached scratchpad registers of all devices.
+ */
+void mgos_dallas_invalidate_scratch_pad_cache(Dallas *dt);
+
+/*
+ * Read device's power requirements, with `addr` NULL of all devices.
+ * Return true if device (any device) needs parasite power.
  * Return always false if an operaiton failed.
  */
 bool mgos_dallas_read_power_supply(Dallas *dt, const uint8_t *addr);
 
+/*
+ * Returns true if device needs parasite power, probed only on the first call
+ * and only if a device on the bus needs parasite power.
+ * Return always false if an operaiton failed.
+ */
+bool mgos_dallas_is_parasite(Dallas *dt, const uint8_t *addr);
+
 /*
  * Get global resolution.
  */
@@ -101,6 +183,16 @@ int mgos_dallas_get_global_resolution(Dallas *dt);
  */
 void mgos_dallas_set_global_resolution(Dallas *dt, int res);
 
+/*
+ * Set the resolution of all devices to 9, 10, 11, or 12 bits, broadcast when
+ * possible. With `copy_to_eeprom` the registers of all devices are also
+ * copied to their EEPROM, with `verify` every device is read back.
+ * Returns false if a device read back failed or kept another resolution, or
+ * if an operaiton failed.
+ */
+bool mgos_dallas_set_global_resolution_ex(Dallas *dt, int res,
+                                          bool copy_to_eeprom, bool verify);
+
 /*
  * Returns the device resolution: 9, 10, 11, or 12 bits.
  * Returns 0 if device not found or if an operation failed.
@@ -116,6 +208,47 @@ int mgos_dallas_get_resolution(Dallas *dt, const uint8_t *addr);
 bool mgos_dallas_set_resolution(Dallas *dt, const uint8_t *addr, int res,
                                 bool skip_global_calc);
 
+/*
+ * Gets the alarm thresholds (TH, TL) of a device in degrees C.
+ * Returns false if the device is not connected or if an operaiton failed.
+ * Returns true otherwise.
+ */
+bool mgos_dallas_get_alarm_thresholds(Dallas *dt, const uint8_t *addr,
+                                      int8_t *low, int8_t *high);
+
+/*
+ * Sets the alarm thresholds (TH, TL) of all devices in degrees C.
+ */
+void mgos_dallas_set_global_alarm_thresholds(Dallas *dt, int low, int high);
+
+/*
+ * Sets the alarm thresholds (TH, TL) of a device in degrees C.
+ * Returns false if the device is not connected or if an operaiton failed.
+ * Returns true otherwise.
+ */
+bool mgos_dallas_set_alarm_thresholds(Dallas *dt, const uint8_t *addr, int low,
+                                      int high);
+
+/*
+ * Restarts the alarm search.
+ */
+void mgos_dallas_reset_alarm_search(Dallas *dt);
+
+/*
+ * Finds the next device with an alarm condition.
+ * Returns false when there are no more devices or if an operaiton failed.
+ * Returns true otherwise.
+ */
+bool mgos_dallas_alarm_search(Dallas *dt, uint8_t *addr);
+
+/*
+ * Stores the indexes of the devices with an alarm condition in `indexes` (at
+ * most `n`).
+ * Returns the number of devices with an alarm condition
+ * or 0 if an operaiton failed.
+ */
+int mgos_dallas_get_alarm_devices(Dallas *dt, uint8_t *indexes, int n);
+
 /*
  * Sets the waitForConversion flag.
  */
@@ -138,6 +271,62 @@ void mgos_dallas_set_check_for_conversion(Dallas *dt, bool f);
  */
 bool mgos_dallas_get_check_for_conversion(Dallas *dt);
 
+/*
+ * Sets the overdrive flag: devices supporting it are addressed at overdrive
+ * speed if the 1-Wire backend supports it.
+ */
+void mgos_dallas_set_overdrive(Dallas *dt, bool f);
+
+/*
+ * Gets the value of the overdrive flag.
+ * Return always false if an operaiton failed.
+ */
+bool mgos_dallas_get_overdrive(Dallas *dt);
+
+/*
+ * Sets the shortRead flag: only the temperature bytes of the scratchpad are
+ * read, implausible values are read again in full.
+ */
+void mgos_dallas_set_short_read(Dallas *dt, bool f);
+
+/*
+ * Gets the value of the shortRead flag.
+ * Return always false if an operaiton failed.
+ */
+bool mgos_dallas_get_short_read(Dallas *dt);
+
+/*
+ * Sets the quarantine threshold: a device failing `n` consecutive reads is
+ * skipped for 1, 2, 4, ... up to 64 reads while it keeps failing, 0 disables
+ * the quarantine.
+ */
+void mgos_dallas_set_quarantine_threshold(Dallas *dt, int n);
+
+/*
+ * Gets the quarantine threshold.
+ * Return always 0 if an operaiton failed.
+ */
+int mgos_dallas_get_quarantine_threshold(Dallas *dt);
+
+/*
+ * Gets the read errors of the device at index `idx`: CRC failures, missing
+ * presence pulses and consecutive failed reads. The pointers may be NULL.
+ * Return false if an operaiton failed.
+ */
+bool mgos_dallas_get_device_errors(Dallas *dt, int idx, int *crc,
+                                   int *presence, int *consecutive);
+
+/*
+ * Returns true if the device at index `idx` is in quarantine.
+ * Return always false if an operaiton failed.
+ */
+bool mgos_dallas_is_quarantined(Dallas *dt, int idx);
+
+/*
+ * Clears the read errors of all devices. Return value: none.
+ */
+void mgos_dallas_reset_device_errors(Dallas *dt);
+
 /*
  * Sends command for all devices on the bus to perform a temperature conversion.
  * Returns false if a device is disconnected or if an operaiton failed.
@@ -145,6 +334,42 @@ bool mgos_dallas_get_check_for_conversion(Dallas *dt);
  */
 void mgos_dallas_request_temperatures(Dallas *dt);
 
+/*
+ * Sends command for all devices on the bus to perform a temperature conversion
+ * and returns immediately. `cb` is called from a timer when the results can be
+ * read.
+ * Returns false if a conversion is already pending or if an operaiton failed.
+ * Returns true otherwise.
+ */
+bool mgos_dallas_request_temperatures_async(Dallas *dt,
+                                            mgos_dallas_conversion_cb_t cb,
+                                            void *arg);
+
+/*
+ * Sends command for all devices on the bus to perform a temperature conversion
+ * and returns immediately. The devices are then read in groups of equal
+ * resolution, each group as soon as its conversion time has elapsed, filling
+ * `raw` and `status` as mgos_dallas_read_all_results() does. `cb` is called
+ * after each group. The buffers must stay valid until the last group was
+ * read.
+ * Returns false if a conversion is already pending or if an operaiton failed.
+ * Returns true otherwise.
+ */
+bool mgos_dallas_read_all_staged_async(Dallas *dt, int16_t *raw,
+                                       uint8_t *status, int n,
+                                       mgos_dallas_stage_cb_t cb, void *arg);
+
+/*
+ * Returns true if an asynchronous conversion is pending.
+ * Return always false if an operaiton failed.
+ */
+bool mgos_dallas_is_conversion_pending(Dallas *dt);
+
+/*
+ * Cancels the pending asynchronous conversion without calling its callback.
+ */
+void mgos_dallas_cancel_conversion(Dallas *dt);
+
 /*
  * Sends command for one device to perform a temperature conversion by address.
  * Returns false if a device is disconnected or if an operaiton failed.
@@ -167,29 +392,74 @@ bool mgos_dallas_request_temperatures_by_index(Dallas *dt, int idx);
 int16_t mgos_dallas_get_temp(Dallas *dt, const uint8_t *addr);
 
 /*
- * Returns temperature in degrees C * 100
+ * Converts and reads all the devices found by mgos_dallas_begin() in one pass.
+ * Fills at most `n` entries of `raw` (raw value or DEVICE_DISCONNECTED_RAW)
+ * and, if not NULL, of `status` (DEVICE_READ_*), in device order.
+ * Returns the number of devices read successfully
+ * or 0 if an operaiton failed.
+ */
+int mgos_dallas_read_all(Dallas *dt, int16_t *raw, uint8_t *status, int n);
+
+/*
+ * Same as mgos_dallas_read_all() but without starting a conversion, e.g. from
+ * the callback of mgos_dallas_request_temperatures_async().
+ */
+int mgos_dallas_read_all_results(Dallas *dt, int16_t *raw, uint8_t *status,
+                                 int n);
+
+/*
+ * Same as mgos_dallas_read_all_results() but only for the devices with the
+ * given resolution, the other entries are left untouched.
+ */
+int mgos_dallas_read_results_by_resolution(Dallas *dt, int res, int16_t *raw,
+                                           uint8_t *status, int n);
+
+/*
+ * Returns temperature in degrees C * 100, computed without floating
+ * point, DEVICE_DISCONNECTED_C * 100 if the device cannot be read
  * or DEVICE_DISCONNECTED_C if an operaiton failed.
  */
 int mgos_dallas_get_tempc(Dallas *dt, const uint8_t *addr);
 
 /*
- * Returns temperature in degrees F * 100
+ * Returns temperature in degrees F * 100, computed without floating
+ * point, DEVICE_DISCONNECTED_F * 100 if the device cannot be read
  * or DEVICE_DISCONNECTED_F if an operaiton failed.
  */
 int mgos_dallas_get_tempf(Dallas *dt, const uint8_t *addr);
 
 /*
- * Returns temperature for device index in degrees C * 100 (slow)
+ * Returns temperature for device index in degrees C * 100, computed without
+ * floating point, DEVICE_DISCONNECTED_C * 100 if the device cannot be read
  * or DEVICE_DISCONNECTED_C if an operaiton failed.
  */
 int mgos_dallas_get_tempc_by_index(Dallas *dt, int idx);
 
 /*
- * Returns temperature for device index in degrees F * 100 (slow)
+ * Returns temperature for device index in degrees F * 100, computed without
+ * floating point, DEVICE_DISCONNECTED_F * 100 if the device cannot be read
  * or DEVICE_DISCONNECTED_F if an operaiton failed.
  */
 int mgos_dallas_get_tempf_by_index(Dallas *dt, int idx);
 
+/*
+ * Converts a raw temperature to degrees C * 100, degrees F * 100 or
+ * degrees C * 1000 without floating point, rounded to nearest.
+ * A disconnected raw value returns DEVICE_DISCONNECTED_C * 100,
+ * DEVICE_DISCONNECTED_F * 100 or DEVICE_DISCONNECTED_C * 1000.
+ */
+int mgos_dallas_raw_to_centi_c(int16_t raw);
+int mgos_dallas_raw_to_centi_f(int16_t raw);
+int mgos_dallas_raw_to_milli_c(int16_t raw);
+
+/*
+ * Converts at most 255 raw temperatures, e.g. filled by mgos_dallas_read_all(),
+ * into `out`. Return value: none.
+ */
+void mgos_dallas_raw_to_centi_c_array(const int16_t *raw, int32_t *out, int n);
+void mgos_dallas_raw_to_centi_f_array(const int16_t *raw, int32_t *out, int n);
+void mgos_dallas_raw_to_milli_c_array(const int16_t *raw, int32_t *out, int n);
+
 /*
  * Returns true if the bus requires parasite power.
  * Returns always false if an operaiton failed.
@@ -209,6 +479,155 @@ bool mgos_dallas_is_conversion_complete(Dallas *dt);
  */
 int16_t mgos_dallas_millis_to_wait_for_conversion(Dallas *dt, int res);
 
+/*
+ * Copies the bus statistics of operation `op` (DALLAS_OP_*) into `stats`.
+ * Returns false if the library was built without DALLAS_BUS_STATS or if an
+ * operaiton failed.
+ * Returns true otherwise.
+ */
+bool mgos_dallas_get_bus_stats(Dallas *dt, int op, DallasBusStats *stats);
+
+/*
+ * Clears the bus statistics of all operations.
+ */
+void mgos_dallas_reset_bus_stats(Dallas *dt);
+
+/*
+ * Creates a group of 1-Wire buses converted and read together.
+ * Return value: handle opaque pointer.
+ */
+DallasBusGroup *mgos_dallas_bus_group_create(void);
+
+/*
+ * Destructor
+ * Close the group handle, the buses are not closed. Return value: none.
+ */
+void mgos_dallas_bus_group_close(DallasBusGroup *grp);
+
+/*
+ * Adds a bus, initialised with mgos_dallas_begin(), to the group.
+ * Returns false if the group is full or if an operaiton failed.
+ * Returns true otherwise.
+ */
+bool mgos_dallas_bus_group_add_bus(DallasBusGroup *grp, Dallas *dt);
+
+/*
+ * Returns the number of devices of all the buses of the group
+ * or 0 if an operaiton failed.
+ */
+int mgos_dallas_bus_group_get_device_count(DallasBusGroup *grp);
+
+/*
+ * Converts on all the buses at once, waits once and reads all the buses.
+ * `raw` and `status` are filled as by mgos_dallas_read_all(), bus after bus.
+ * Returns the number of devices read successfully
+ * or 0 if an operaiton failed.
+ */
+int mgos_dallas_bus_group_read_all(DallasBusGroup *grp, int16_t *raw,
+                                   uint8_t *status, int n);
+
+/*
+ * Creates a store of the last temperatures of each device and their
+ * min/max/mean rollups, sized at compile time.
+ * Return value: handle opaque pointer.
+ */
+DallasSampleStore *mgos_dallas_sample_store_create(void);
+
+/*
+ * Destructor
+ * Close the store handle, detach it from the buses first. Return value: none.
+ */
+void mgos_dallas_sample_store_close(DallasSampleStore *st);
+
+/*
+ * Attaches the store (NULL detaches it) to the bus, the temperatures read by
+ * mgos_dallas_read_all() etc are recorded. Return value: none.
+ */
+void mgos_dallas_set_sample_store(Dallas *dt, DallasSampleStore *st);
+
+/*
+ * Calls `cb` (NULL stops reporting) for the temperatures read by
+ * mgos_dallas_get_temp() etc and mgos_dallas_read_all() etc only when they
+ * move more than `deadband` (raw) away from the last value reported for the
+ * device or when `max_silence_ms` (0: no limit) have passed since that report.
+ * Return value: none.
+ */
+void mgos_dallas_set_change_reporting(Dallas *dt, int deadband,
+                                      int max_silence_ms,
+                                      mgos_dallas_change_cb_t cb, void *arg);
+
+/*
+ * Sets the length in milliseconds of the rollup window `index`, 0 disables it.
+ * Returns false if an operaiton failed.
+ */
+bool mgos_dallas_sample_store_set_window(DallasSampleStore *st, int index,
+                                         int millis);
+
+/*
+ * Copies at most `n` samples of the device, oldest first, into `times`
+ * (milliseconds since boot, may be NULL) and `raw`.
+ * Returns the number of samples copied or 0 if an operaiton failed.
+ */
+int mgos_dallas_sample_store_get_samples(DallasSampleStore *st,
+                                         const uint8_t *addr, uint32_t *times,
+                                         int16_t *raw, int n);
+
+/*
+ * Gets the raw min, max and mean and the sample count of the last complete
+ * (`current` false) or current window `index` of the device. The pointers may
+ * be NULL.
+ * Returns false if the window has no samples or if an operaiton failed.
+ */
+bool mgos_dallas_sample_store_get_rollup(DallasSampleStore *st,
+                                         const uint8_t *addr, int index,
+                                         bool current, int16_t *min,
+                                         int16_t *max, int16_t *mean,
+                                         int *count);
+
+#if DALLAS_BUS_WORKER
+/*
+ * Called from the worker task when a request of `type` (DALLAS_REQUEST_*) is
+ * done, see DallasBusWorker::RequestCallback for `result`.
+ */
+typedef void (*mgos_dallas_worker_cb_t)(DallasBusWorker *wk, uint8_t type,
+                                        int32_t result, void *arg);
+
+/*
+ * Creates and starts a worker task owning the bus, initialised with
+ * mgos_dallas_begin(). The bus must not be used directly any more.
+ * Return value: handle opaque pointer or NULL if the task could not be
+ * started.
+ */
+DallasBusWorker *mgos_dallas_worker_create(Dallas *dt, int stack_size,
+                                           int priority);
+
+/*
+ * Destructor
+ * Stops the worker task after the requests already queued have been served
+ * and waits for it to exit, the bus is not closed. Must not be called from a
+ * worker callback. Return value: none.
+ */
+void mgos_dallas_worker_close(DallasBusWorker *wk);
+
+/*
+ * Queue a request, `cb` (may be NULL) is called when it is done.
+ * mgos_dallas_worker_read_all() reads the results of the last conversion,
+ * `raw` and `status` (may be NULL) must stay valid until then.
+ * Return false if the queue is full or if an operaiton failed.
+ */
+bool mgos_dallas_worker_convert(DallasBusWorker *wk, mgos_dallas_worker_cb_t cb,
+                                void *arg);
+bool mgos_dallas_worker_read(DallasBusWorker *wk, const uint8_t *addr,
+                             mgos_dallas_worker_cb_t cb, void *arg);
+bool mgos_dallas_worker_read_all(DallasBusWorker *wk, int16_t *raw,
+                                 uint8_t *status, int n,
+                                 mgos_dallas_worker_cb_t cb, void *arg);
+bool mgos_dallas_worker_rescan(DallasBusWorker *wk, mgos_dallas_worker_cb_t cb,
+                               void *arg);
+bool mgos_dallas_worker_set_resolution(DallasBusWorker *wk, int res,
+                                       mgos_dallas_worker_cb_t cb, void *arg);
+#endif
+
 #ifdef __cplusplus
 }
 #endif
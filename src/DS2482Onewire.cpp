@@ -0,0 +1,314 @@
+#include <string.h>
+#include "DS2482Onewire.h"
+
+// Bridge commands
+#define DS2482_DEVICE_RESET 0xF0
+#define DS2482_SET_READ_POINTER 0xE1
+#define DS2482_WRITE_CONFIG 0xD2
+#define DS2482_CHANNEL_SELECT 0xC3
+#define DS2482_1W_RESET 0xB4
+#define DS2482_1W_SINGLE_BIT 0x87
+#define DS2482_1W_WRITE_BYTE 0xA5
+#define DS2482_1W_READ_BYTE 0x96
+#define DS2482_1W_TRIPLET 0x78
+
+// Registers (read pointer codes)
+#define DS2482_REG_STATUS 0xF0
+#define DS2482_REG_DATA 0xE1
+
+// Status register
+#define DS2482_STATUS_1WB 0x01  // 1-Wire busy
+#define DS2482_STATUS_PPD 0x02  // presence pulse detected
+#define DS2482_STATUS_SD 0x04   // short detected
+#define DS2482_STATUS_RST 0x10  // device reset
+#define DS2482_STATUS_SBR 0x20  // single bit result
+#define DS2482_STATUS_TSB 0x40  // triplet second bit
+#define DS2482_STATUS_DIR 0x80  // branch direction taken
+
+// Configuration register
+#define DS2482_CONFIG_APU 0x01  // active pullup
+#define DS2482_CONFIG_SPU 0x04  // strong pullup
+#define DS2482_CONFIG_1WS 0x08  // overdrive speed
+
+// ROM commands
+#define SEARCHROM 0xF0
+#define ALARMSEARCH 0xEC
+#define MATCHROM 0x55
+#define SKIPROM 0xCC
+
+// Status polls before a command is considered failed, a reset at standard
+// speed takes about 1.2ms, one poll at 100kHz about 0.2ms
+#define DS2482_POLL_LIMIT 100
+
+// Channel selection codes and the values read back, DS2482-800
+static const uint8_t channelCodes[] = {0xF0, 0xE1, 0xD2, 0xC3,
+                                       0xB4, 0xA5, 0x96, 0x87};
+static const uint8_t channelReadBack[] = {0xB8, 0xB1, 0xAA, 0xA3,
+                                          0x9C, 0x95, 0x8E, 0x87};
+
+#ifdef MGOS_HAVE_I2C
+bool DS2482MgosTransport::write(uint8_t address, const uint8_t *data,
+                                uint8_t len) {
+  return mgos_i2c_write(_i2c, address, data, len, true);
+}
+
+bool DS2482MgosTransport::read(uint8_t address, uint8_t *data, uint8_t len) {
+  return mgos_i2c_read(_i2c, address, data, len, true);
+}
+#endif
+
+DS2482Onewire::DS2482Onewire(DS2482Transport *transport, uint8_t address,
+                             uint8_t channel)
+    : _transport(transport),
+      _address(address),
+      _channel(channel),
+      _config(DS2482_CONFIG_APU) {
+  reset_search();
+}
+
+DS2482Onewire::~DS2482Onewire() {
+}
+
+bool DS2482Onewire::begin(void) {
+  uint8_t status = 0;
+  if (!command(DS2482_DEVICE_RESET) ||
+      !_transport->read(_address, &status, 1) ||
+      (status & DS2482_STATUS_RST) == 0) {
+    return false;
+  }
+  return writeConfig(_config) && selectChannel();
+}
+
+bool DS2482Onewire::command(uint8_t cmd) {
+  return _transport->write(_address, &cmd, 1);
+}
+
+bool DS2482Onewire::command(uint8_t cmd, uint8_t param) {
+  uint8_t buf[2] = {cmd, param};
+  return _transport->write(_address, buf, 2);
+}
+
+/*
+ * the 1-Wire commands leave the read pointer on the status register
+ */
+bool DS2482Onewire::waitIdle(uint8_t *status) {
+  for (int i = 0; i < DS2482_POLL_LIMIT; i++) {
+    if (!_transport->read(_address, status, 1)) {
+      return false;
+    }
+    if ((*status & DS2482_STATUS_1WB) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+/*
+ * the upper nibble holds the complement of the configuration, the register
+ * reads back the lower nibble
+ */
+bool DS2482Onewire::writeConfig(uint8_t config) {
+  uint8_t readBack = 0;
+  if (!command(DS2482_WRITE_CONFIG, (uint8_t)(config | (~config << 4))) ||
+      !_transport->read(_address, &readBack, 1)) {
+    return false;
+  }
+  return (readBack == config);
+}
+
+bool DS2482Onewire::selectChannel(void) {
+  if (_channel == NO_CHANNEL) {
+    return true;
+  }
+  if (_channel >= sizeof(channelCodes)) {
+    return false;
+  }
+  uint8_t readBack = 0;
+  if (!command(DS2482_CHANNEL_SELECT, channelCodes[_channel]) ||
+      !_transport->read(_address, &readBack, 1)) {
+    return false;
+  }
+  return (readBack == channelReadBack[_channel]);
+}
+
+/*
+ * the channels of a DS2482-800 share the configuration register, so both are
+ * restored before the reset of a channel
+ */
+uint8_t DS2482Onewire::reset(void) {
+  uint8_t status = 0;
+  if (_channel != NO_CHANNEL && (!selectChannel() || !writeConfig(_config))) {
+    return 0;
+  }
+  if (!command(DS2482_1W_RESET) || !waitIdle(&status)) {
+    return 0;
+  }
+  if (status & DS2482_STATUS_SD) {
+    return 0;
+  }
+  return (status & DS2482_STATUS_PPD) ? 1 : 0;
+}
+
+void DS2482Onewire::select(const uint8_t rom[8]) {
+  write(MATCHROM);
+  write_bytes(rom, 8);
+}
+
+void DS2482Onewire::skip(void) {
+  write(SKIPROM);
+}
+
+/*
+ * the bridge drops the strong pullup at the next 1-Wire command
+ */
+void DS2482Onewire::write(uint8_t v, uint8_t power) {
+  uint8_t status;
+  if (power) {
+    writeConfig(_config | DS2482_CONFIG_SPU);
+  }
+  if (command(DS2482_1W_WRITE_BYTE, v)) {
+    waitIdle(&status);
+  }
+}
+
+void DS2482Onewire::write_bytes(const uint8_t *buf, uint16_t count,
+                                bool power) {
+  for (uint16_t i = 0; i < count; i++) {
+    write(buf[i], (i == count - 1) ? power : 0);
+  }
+}
+
+/*
+ * returns 0xFF (idle bus) on errors
+ */
+uint8_t DS2482Onewire::read(void) {
+  uint8_t status;
+  uint8_t v = 0xFF;
+  if (!command(DS2482_1W_READ_BYTE) || !waitIdle(&status) ||
+      !command(DS2482_SET_READ_POINTER, DS2482_REG_DATA) ||
+      !_transport->read(_address, &v, 1)) {
+    return 0xFF;
+  }
+  return v;
+}
+
+void DS2482Onewire::read_bytes(uint8_t *buf, uint16_t count) {
+  for (uint16_t i = 0; i < count; i++) {
+    buf[i] = read();
+  }
+}
+
+void DS2482Onewire::write_bit(uint8_t v) {
+  uint8_t status;
+  if (command(DS2482_1W_SINGLE_BIT, v ? 0x80 : 0x00)) {
+    waitIdle(&status);
+  }
+}
+
+/*
+ * returns 1 (idle bus) on errors
+ */
+uint8_t DS2482Onewire::read_bit(void) {
+  uint8_t status;
+  if (!command(DS2482_1W_SINGLE_BIT, 0x80) || !waitIdle(&status)) {
+    return 1;
+  }
+  return (status & DS2482_STATUS_SBR) ? 1 : 0;
+}
+
+void DS2482Onewire::depower(void) {
+  writeConfig(_config);
+}
+
+void DS2482Onewire::reset_search() {
+  memset(_searchRom, 0, sizeof(_searchRom));
+  _lastDiscrepancy = 0;
+  _lastFamilyDiscrepancy = 0;
+  _lastDeviceFlag = false;
+}
+
+void DS2482Onewire::target_search(uint8_t family_code) {
+  memset(_searchRom, 0, sizeof(_searchRom));
+  _searchRom[0] = family_code;
+  _lastDiscrepancy = 64;
+  _lastFamilyDiscrepancy = 0;
+  _lastDeviceFlag = false;
+}
+
+uint8_t DS2482Onewire::triplet(uint8_t direction) {
+  uint8_t status;
+  if (!command(DS2482_1W_TRIPLET, direction ? 0x80 : 0x00) ||
+      !waitIdle(&status)) {
+    return 0xFF;
+  }
+  return status;
+}
+
+/*
+ * same algorithm as the bit-banged OneWire search, the bridge reads both bits
+ * and writes the direction in one triplet command
+ */
+uint8_t DS2482Onewire::search(uint8_t *newAddr, bool search_mode) {
+  if (_lastDeviceFlag || !reset()) {
+    reset_search();
+    return 0;
+  }
+
+  write(search_mode ? SEARCHROM : ALARMSEARCH);
+
+  uint8_t lastZero = 0;
+  for (uint8_t bit = 1; bit <= 64; bit++) {
+    uint8_t byte = (bit - 1) / 8;
+    uint8_t mask = 1 << ((bit - 1) % 8);
+
+    uint8_t direction;
+    if (bit < _lastDiscrepancy) {
+      direction = (_searchRom[byte] & mask) ? 1 : 0;
+    } else {
+      direction = (bit == _lastDiscrepancy) ? 1 : 0;
+    }
+
+    uint8_t status = triplet(direction);
+    bool idBit = status & DS2482_STATUS_SBR;
+    bool cmpBit = status & DS2482_STATUS_TSB;
+    direction = (status & DS2482_STATUS_DIR) ? 1 : 0;
+    if (idBit && cmpBit) {
+      // no device participates
+      reset_search();
+      return 0;
+    }
+    if (!idBit && !cmpBit && direction == 0) {
+      lastZero = bit;
+      if (lastZero < 9) {
+        _lastFamilyDiscrepancy = lastZero;
+      }
+    }
+
+    if (direction) {
+      _searchRom[byte] |= mask;
+    } else {
+      _searchRom[byte] &= ~mask;
+    }
+  }
+
+  _lastDiscrepancy = lastZero;
+  if (_lastDiscrepancy == 0) {
+    _lastDeviceFlag = true;
+  }
+  memcpy(newAddr, _searchRom, sizeof(_searchRom));
+  return 1;
+}
+
+bool DS2482Onewire::has_overdrive(void) {
+  return true;
+}
+
+bool DS2482Onewire::set_overdrive(bool overdrive) {
+  uint8_t config = overdrive ? (_config | DS2482_CONFIG_1WS)
+                             : (_config & ~DS2482_CONFIG_1WS);
+  if (!writeConfig(config)) {
+    return false;
+  }
+  _config = config;
+  return true;
+}
@@ -0,0 +1,129 @@
+#pragma once
+#include <stdint.h>
+#include "OnewireInterface.h"
+
+/*
+ * I2C transport of DS2482Onewire, addresses are 7-bit
+ */
+class DS2482Transport {
+ public:
+  virtual ~DS2482Transport() {
+  }
+
+  /*
+   * Writes len bytes, returns false if the device does not acknowledge
+   */
+  virtual bool write(uint8_t address, const uint8_t *data, uint8_t len) = 0;
+
+  /*
+   * Reads len bytes, returns false if the device does not acknowledge
+   */
+  virtual bool read(uint8_t address, uint8_t *data, uint8_t len) = 0;
+};
+
+#ifdef MGOS_HAVE_I2C
+#include <mgos_i2c.h>
+
+/*
+ * DS2482Transport on a Mongoose OS I2C bus
+ */
+class DS2482MgosTransport : public DS2482Transport {
+ public:
+  DS2482MgosTransport(struct mgos_i2c *i2c) : _i2c(i2c) {
+  }
+
+  virtual bool write(uint8_t address, const uint8_t *data, uint8_t len);
+  virtual bool read(uint8_t address, uint8_t *data, uint8_t len);
+
+ protected:
+  struct mgos_i2c *_i2c;
+};
+#endif
+
+/*
+ * 1-Wire bus driven by a DS2482-100 or one channel of a DS2482-800 I2C to
+ * 1-Wire bridge. The bridge generates the reset, bit, byte and search triplet
+ * time slots, so the CPU does not spend time on the slot timing.
+ *
+ * Several instances may share one DS2482-800, one per channel: the channel
+ * and the configuration of the instance are restored at every reset.
+ */
+class DS2482Onewire : public OnewireInterface {
+ public:
+  /*
+   * channel of a DS2482-100, which has no channel selection register
+   */
+  static const uint8_t NO_CHANNEL = 0xFF;
+
+  /*
+   * address: 7-bit I2C address of the bridge (0x18 - 0x1B for the DS2482-100,
+   * 0x18 - 0x1F for the DS2482-800)
+   * channel: 0 - 7 on a DS2482-800, NO_CHANNEL on a DS2482-100
+   */
+  DS2482Onewire(DS2482Transport *transport, uint8_t address = 0x18,
+                uint8_t channel = NO_CHANNEL);
+  virtual ~DS2482Onewire();
+
+  /*
+   * Resets the bridge, writes the configuration (active pullup) and selects
+   * the channel.
+   * Returns false if the bridge does not answer.
+   */
+  bool begin(void);
+
+  /*
+   * OnewireInterface
+   */
+  virtual uint8_t reset(void);
+  virtual void select(const uint8_t rom[8]);
+  virtual void skip(void);
+  virtual void write(uint8_t v, uint8_t power = 0);
+  virtual void write_bytes(const uint8_t *buf, uint16_t count,
+                           bool power = 0);
+  virtual uint8_t read(void);
+  virtual void read_bytes(uint8_t *buf, uint16_t count);
+  virtual void write_bit(uint8_t v);
+  virtual uint8_t read_bit(void);
+  virtual void depower(void);
+  virtual void reset_search();
+  virtual void target_search(uint8_t family_code);
+  virtual uint8_t search(uint8_t *newAddr, bool search_mode = true);
+  virtual bool has_overdrive(void);
+  virtual bool set_overdrive(bool overdrive);
+
+ protected:
+  DS2482Transport *_transport;
+  uint8_t _address;
+  uint8_t _channel;
+  uint8_t _config;  // configuration without the strong pullup bit
+
+  /*
+   * Master side search state
+   */
+  uint8_t _searchRom[8];
+  uint8_t _lastDiscrepancy;
+  uint8_t _lastFamilyDiscrepancy;
+  bool _lastDeviceFlag;
+
+  /*
+   * Sends a command with an optional parameter
+   */
+  bool command(uint8_t cmd);
+  bool command(uint8_t cmd, uint8_t param);
+
+  /*
+   * Polls the status register until the 1-Wire line is idle.
+   * Returns false on I2C errors or timeout.
+   */
+  bool waitIdle(uint8_t *status);
+
+  bool writeConfig(uint8_t config);
+  bool selectChannel(void);
+
+  /*
+   * Runs one search step: reads a bit and its complement and writes the
+   * direction taken by the bridge.
+   * Returns the status register or 0xFF on errors.
+   */
+  uint8_t triplet(uint8_t direction);
+};
@@ -1,5 +1,8 @@
 #include <mgos.h>
+#include <stdio.h>
+#include <string.h>
 #include "Dallas.h"
+#include "DallasSampleStore.h"
 #include "OnewireInterface.h"
 
 // Model IDs
@@ -9,6 +12,11 @@
 #define DS1825MODEL 0x3B
 #define DS28EA00MODEL 0x42
 
+// Families enumerated by the device table, one targeted search each
+static const uint8_t searchFamilies[] = {DS18S20MODEL, DS1822MODEL,
+                                         DS18B20MODEL, DS1825MODEL,
+                                         DS28EA00MODEL};
+
 // OneWire commands
 #define STARTCONVO \
   0x44  // Tells device to take a temperature reading and put it on the
@@ -37,52 +45,646 @@
 #define TEMP_11_BIT 0x5F  // 11 bit
 #define TEMP_12_BIT 0x7F  // 12 bit
 
+// Temperature register read by a short read: power-on value (85 C) and the
+// limits of the measurement range (-55 C to +125 C) in 1/16 C
+#define POWER_ON_TEMP 0x0550
+#define MIN_TEMP_REGISTER (-55 * 16)
+#define MAX_TEMP_REGISTER (125 * 16)
+
+// Longest quarantine in skipped reads, 2^QUARANTINE_MAX_SHIFT
+#define QUARANTINE_MAX_SHIFT 6
+
+// Consecutive reads failing at overdrive speed but not at standard speed
+// before a device is addressed at standard speed only
+#define OVERDRIVE_MAX_FAILURES 3
+
+// Time a copy of the scratchpad to EEPROM takes, in microseconds
+#define COPY_SCRATCH_MICROS 10000
+
+// Interval between two checks of an asynchronous conversion
+#define CONVERSION_POLL_MS 10
+
+// Standard and overdrive speed timings in microseconds, used to estimate the
+// bus time
+#define RESET_MICROS 960
+#define SLOT_MICROS 70
+#define OVERDRIVE_SLOT_MICROS 10
+
+#if DALLAS_BUS_STATS
+/*
+ * Attributes the bus traffic to the outermost public operation
+ */
+class BusStatsScope {
+ public:
+  BusStatsScope(DallasBusStats *stats, uint8_t &current, uint8_t op)
+      : _current(current), _previous(current) {
+    if (_current == DALLAS_OP_OTHER) {
+      _current = op;
+      stats[op].calls++;
+    }
+  }
+  ~BusStatsScope() {
+    _current = _previous;
+  }
+
+ private:
+  uint8_t &_current;
+  uint8_t _previous;
+};
+
+#define BUS_STATS_OP(op) BusStatsScope busStatsScope(_busStats, _busStatsOp, op)
+#define BUS_STATS_ADD(field, n) (_busStats[_busStatsOp].field += (n))
+#else
+#define BUS_STATS_OP(op)
+#define BUS_STATS_ADD(field, n)
+#endif
+
+#define BUS_SLOT_MICROS (_overdriveActive ? OVERDRIVE_SLOT_MICROS : SLOT_MICROS)
+
+// Inventory file: magic and version, device count and CRC, then per device
+// the address, resolution, flags and CRC
+static const uint8_t inventoryMagic[] = {'D', 'L', 'S', 1};
+#define INVENTORY_HEADER_LEN 6
+#define INVENTORY_RECORD_LEN 11
+#define INVENTORY_PARASITE 0x01
+#define INVENTORY_PARASITE_KNOWN 0x02
+
+// Largest transaction built by Dallas
+#define TRANSACTION_OPS 8
+#define TRANSACTION_DATA 8
+
+/*
+ * ops of one bus transaction, filled by the Dallas::ow* primitives and run by
+ * Dallas::owRun() in one OnewireInterface::transact() call
+ */
+class OwTransaction {
+ public:
+  OwTransaction() : count(0), dataLen(0) {
+  }
+
+  OwOp *add(uint8_t type) {
+    OwOp *op = &ops[count++];
+    op->type = type;
+    op->arg = 0;
+    op->len = 0;
+    op->data = NULL;
+    op->buf = NULL;
+    return op;
+  }
+
+  OwOp ops[TRANSACTION_OPS];
+  uint8_t count;
+  uint8_t data[TRANSACTION_DATA];  // bytes written by the OW_OP_WRITE ops
+  uint8_t dataLen;
+};
+
+/*
+ * every transaction starts with a reset at standard speed, which also returns
+ * the devices to standard speed
+ */
+inline void Dallas::owReset(OwTransaction &t) {
+  if (_overdriveActive) {
+    t.add(OW_OP_SPEED);
+    _overdriveActive = false;
+  }
+  BUS_STATS_ADD(resets, 1);
+  BUS_STATS_ADD(busMicros, RESET_MICROS);
+  t.add(OW_OP_RESET);
+}
+
+/*
+ * overdrive capable devices are matched at overdrive speed and the rest of the
+ * transaction runs at that speed
+ */
+inline void Dallas::owSelect(OwTransaction &t, const uint8_t *deviceAddress) {
+  BUS_STATS_ADD(selects, 1);
+  BUS_STATS_ADD(bytesWritten, 9);
+  if (_overdrive && deviceAddress[0] == DS28EA00MODEL &&
+      selectsOverdrive(findDevice(deviceAddress))) {
+    BUS_STATS_ADD(busMicros, 8 * SLOT_MICROS + 64 * OVERDRIVE_SLOT_MICROS);
+    t.add(OW_OP_OVERDRIVE_SELECT)->data = deviceAddress;
+    _overdriveActive = true;
+    return;
+  }
+  BUS_STATS_ADD(busMicros, 9 * 8 * SLOT_MICROS);
+  t.add(OW_OP_SELECT)->data = deviceAddress;
+}
+
+inline void Dallas::owSkip(OwTransaction &t) {
+  BUS_STATS_ADD(bytesWritten, 1);
+  BUS_STATS_ADD(busMicros, 8 * SLOT_MICROS);
+  t.add(OW_OP_SKIP);
+}
+
+inline void Dallas::owOverdriveSkip(OwTransaction &t) {
+  BUS_STATS_ADD(bytesWritten, 1);
+  BUS_STATS_ADD(busMicros, 8 * SLOT_MICROS);
+  t.add(OW_OP_OVERDRIVE_SKIP);
+  _overdriveActive = true;
+}
+
+/*
+ * consecutive writes are merged into one op
+ */
+inline void Dallas::owWrite(OwTransaction &t, uint8_t v, uint8_t power) {
+  BUS_STATS_ADD(bytesWritten, 1);
+  BUS_STATS_ADD(busMicros, 8 * BUS_SLOT_MICROS);
+  OwOp *last = (t.count > 0) ? &t.ops[t.count - 1] : NULL;
+  t.data[t.dataLen] = v;
+  if (last != NULL && last->type == OW_OP_WRITE &&
+      last->data + last->len == &t.data[t.dataLen]) {
+    last->len++;
+    last->arg = power;
+  } else {
+    OwOp *op = t.add(OW_OP_WRITE);
+    op->arg = power;
+    op->len = 1;
+    op->data = &t.data[t.dataLen];
+  }
+  t.dataLen++;
+}
+
+inline void Dallas::owReadBytes(OwTransaction &t, uint8_t *buf,
+                                uint16_t count) {
+  BUS_STATS_ADD(bytesRead, count);
+  BUS_STATS_ADD(busMicros, count * 8 * BUS_SLOT_MICROS);
+  OwOp *op = t.add(OW_OP_READ);
+  op->len = count;
+  op->buf = buf;
+}
+
+inline void Dallas::owReadBit(OwTransaction &t, uint8_t *bit) {
+  BUS_STATS_ADD(bitsRead, 1);
+  BUS_STATS_ADD(busMicros, BUS_SLOT_MICROS);
+  t.add(OW_OP_READ_BIT)->buf = bit;
+}
+
+/*
+ * returns false if a reset of the transaction found no device
+ */
+inline bool Dallas::owRun(OwTransaction &t) {
+  return _ow->transact(t.ops, t.count);
+}
+
+/*
+ * a search step is a reset, the search command and 64 triplets (two read
+ * slots and one write slot each)
+ */
+inline uint8_t Dallas::owSearch(uint8_t *deviceAddress, bool searchMode) {
+  if (_overdriveActive) {
+    _ow->set_overdrive(false);
+    _overdriveActive = false;
+  }
+  BUS_STATS_ADD(searches, 1);
+  BUS_STATS_ADD(resets, 1);
+  BUS_STATS_ADD(bytesWritten, 1);
+  BUS_STATS_ADD(bitsRead, 128);
+  BUS_STATS_ADD(bitsWritten, 64);
+  BUS_STATS_ADD(busMicros, RESET_MICROS + (8 + 192) * SLOT_MICROS);
+  return _ow->search(deviceAddress, searchMode);
+}
+
 Dallas::Dallas()
     : _devices(0),
+      _deviceTable(NULL),
+      _deviceTableSize(0),
       _parasite(false),
       _bitResolution(9),
       _waitForConversion(true),
       _checkForConversion(true),
+      _overdrive(true),
+      _overdriveActive(false),
+      _shortRead(false),
+      _quarantineThreshold(0),
+      _sampleStore(NULL),
+      _changeCb(NULL),
+      _changeCbArg(NULL),
+      _changeDeadband(0),
+      _changeMaxSilence(0),
       _ow(NULL),
-      _ownOnewire(false) {
+      _ownOnewire(false),
+      _conversionTimer(MGOS_INVALID_TIMER_ID),
+      _conversionCb(NULL),
+      _conversionCbArg(NULL),
+      _conversionDeadline(0),
+      _stageCb(NULL),
+      _stageRaw(NULL),
+      _stageStatus(NULL),
+      _stageCount(0),
+      _stageResolution(0),
+      _stagePoll(false),
+      _conversionStart(0) {
+#if DALLAS_BUS_STATS
+  _busStatsOp = DALLAS_OP_OTHER;
+  resetBusStats();
+#endif
 }
 
 Dallas::~Dallas() {
+  cancelConversion();
   if (_ownOnewire) {
     delete _ow;
   }
+  delete[] _deviceTable;
 }
 
 void Dallas::setOneWire(OnewireInterface *ow) {
+  cancelConversion();
   if (_ownOnewire) {
     delete _ow;
     _ow = NULL;
   }
   _ow = ow;
   _devices = 0;
+  delete[] _deviceTable;
+  _deviceTable = NULL;
+  _deviceTableSize = 0;
   _parasite = false;
   _bitResolution = 9;
   _waitForConversion = true;
   _checkForConversion = true;
+  _overdriveActive = false;
 }
 
 /*
  * initialise the bus
  */
 void Dallas::begin(void) {
+  refreshDeviceTable();
+}
+
+/*
+ * searches the bus and stores every valid address, together with its
+ * resolution, in the device table. The power mode is checked for the whole
+ * bus
+ */
+uint8_t Dallas::refreshDeviceTable(void) {
+  BUS_STATS_OP(DALLAS_OP_BEGIN);
+
   DeviceAddress deviceAddress;
+  uint8_t family = 0;
 
-  _ow->reset_search();
   _devices = 0;  // Reset the number of devices when we enumerate wire devices
 
-  while (_ow->search(deviceAddress)) {
-    if (validAddress(deviceAddress)) {
-      if (!_parasite && readPowerSupply(deviceAddress)) {
-        _parasite = true;
+  while (searchDevice(deviceAddress, &family)) {
+    DeviceInfo *info = addDevice(deviceAddress);
+    if (info == NULL) {
+      break;  // table full
+    }
+    info->resolution = getResolution(deviceAddress);
+  }
+  checkParasite();
+  updateBusInfo();
+  return _devices;
+}
+
+/*
+ * finds the next device of a supported family with a valid address
+ * runs one targeted search per family and moves to the next family as soon as
+ * the search returns a device of another family, so the branches of other
+ * devices are not walked
+ * *family must be 0 before the first call
+ */
+bool Dallas::searchDevice(uint8_t *deviceAddress, uint8_t *family) {
+  if (*family == 0) {
+    _ow->target_search(searchFamilies[0]);
+    *family = 1;
+  }
+  while (*family <= sizeof(searchFamilies)) {
+    if (owSearch(deviceAddress) &&
+        deviceAddress[0] == searchFamilies[*family - 1]) {
+      if (validAddress(deviceAddress)) {
+        return true;
       }
-      _bitResolution = MAX(_bitResolution, getResolution(deviceAddress));
-      _devices++;
+      continue;
+    }
+    (*family)++;
+    if (*family <= sizeof(searchFamilies)) {
+      _ow->target_search(searchFamilies[*family - 1]);
+    }
+  }
+  return false;
+}
+
+/*
+ * diffs a fresh search against the device table, only new devices are queried
+ */
+uint16_t Dallas::rescan(DeviceChangeCallback cb, void *arg) {
+  BUS_STATS_OP(DALLAS_OP_RESCAN);
+
+  DeviceAddress deviceAddress;
+  uint8_t known = _devices;
+  bool *seen = new bool[known + 1];
+  memset(seen, 0, known + 1);
+
+  /*
+   * the search order is deterministic, so the next known device is usually
+   * the one after the previous match
+   */
+  uint8_t next = 0;
+  uint8_t family = 0;
+  while (searchDevice(deviceAddress, &family)) {
+    int index = -1;
+    if (next < known && memcmp(_deviceTable[next].address, deviceAddress,
+                               sizeof(DeviceAddress)) == 0) {
+      index = next;
+    } else {
+      DeviceInfo *info = findDevice(deviceAddress);
+      if (info != NULL) {
+        index = info - _deviceTable;
+      }
+    }
+
+    if (index >= known) {
+      continue;  // found twice
+    } else if (index >= 0) {
+      seen[index] = true;
+      next = index + 1;
+    } else {
+      DeviceInfo *info = addDevice(deviceAddress);
+      if (info == NULL) {
+        break;  // table full
+      }
+      info->resolution = getResolution(deviceAddress);
+    }
+  }
+
+  // report and drop the devices not found any more, keeping the order
+  uint16_t changes = 0;
+  uint8_t devices = 0;
+  for (uint8_t i = 0; i < _devices; i++) {
+    if (i < known && !seen[i]) {
+      if (cb != NULL) {
+        cb(this, _deviceTable[i].address, false, arg);
+      }
+      changes++;
+      continue;
+    }
+    if (devices != i) {
+      _deviceTable[devices] = _deviceTable[i];
+    }
+    devices++;
+  }
+  delete[] seen;
+
+  uint8_t added = _devices - known;
+  _devices = devices;
+  for (uint8_t i = _devices - added; i < _devices; i++) {
+    if (cb != NULL) {
+      cb(this, _deviceTable[i].address, true, arg);
+    }
+    changes++;
+  }
+
+  // a removed device may have been the parasite powered one
+  if (changes > 0) {
+    checkParasite();
+  }
+  updateBusInfo();
+  return changes;
+}
+
+void Dallas::updateBusInfo(void) {
+  _parasite = false;
+  _bitResolution = 9;
+  for (uint8_t i = 0; i < _devices; i++) {
+    _parasite = _parasite || _deviceTable[i].parasite ||
+                !_deviceTable[i].parasiteKnown;
+    _bitResolution = MAX(_bitResolution, _deviceTable[i].resolution);
+  }
+}
+
+bool Dallas::saveInventory(const char *path) {
+  FILE *f = fopen(path, "wb");
+  if (f == NULL) {
+    return false;
+  }
+
+  uint8_t buf[INVENTORY_RECORD_LEN];
+  memcpy(buf, inventoryMagic, sizeof(inventoryMagic));
+  buf[4] = _devices;
+  buf[5] = crc8(buf, 5);
+  bool ok = (fwrite(buf, 1, INVENTORY_HEADER_LEN, f) == INVENTORY_HEADER_LEN);
+  for (uint8_t i = 0; ok && i < _devices; i++) {
+    const DeviceInfo *info = &_deviceTable[i];
+    memcpy(buf, info->address, sizeof(DeviceAddress));
+    buf[8] = info->resolution;
+    buf[9] = (info->parasite ? INVENTORY_PARASITE : 0) |
+             (info->parasiteKnown ? INVENTORY_PARASITE_KNOWN : 0);
+    buf[10] = crc8(buf, 10);
+    ok = (fwrite(buf, 1, INVENTORY_RECORD_LEN, f) == INVENTORY_RECORD_LEN);
+  }
+  if (fclose(f) != 0) {
+    ok = false;
+  }
+  return ok;
+}
+
+/*
+ * replaces the device table with the saved one, the power mode and
+ * resolution are taken from the file instead of being read from every device
+ */
+bool Dallas::loadInventory(const char *path, uint8_t samples) {
+  BUS_STATS_OP(DALLAS_OP_BEGIN);
+
+  FILE *f = fopen(path, "rb");
+  if (f == NULL) {
+    return false;
+  }
+
+  _devices = 0;
+  uint8_t buf[INVENTORY_RECORD_LEN];
+  bool ok = (fread(buf, 1, INVENTORY_HEADER_LEN, f) == INVENTORY_HEADER_LEN) &&
+            (memcmp(buf, inventoryMagic, sizeof(inventoryMagic)) == 0) &&
+            (crc8(buf, 5) == buf[5]);
+  uint8_t count = ok ? buf[4] : 0;
+  for (uint8_t i = 0; ok && i < count; i++) {
+    ok = (fread(buf, 1, INVENTORY_RECORD_LEN, f) == INVENTORY_RECORD_LEN) &&
+         (crc8(buf, 10) == buf[10]) && validAddress(buf) && validFamily(buf);
+    DeviceInfo *info = ok ? addDevice(buf) : NULL;
+    if (info == NULL) {
+      ok = false;
+      break;
     }
+    info->resolution = buf[8];
+    info->parasite = (buf[9] & INVENTORY_PARASITE) != 0;
+    info->parasiteKnown = (buf[9] & INVENTORY_PARASITE_KNOWN) != 0;
+  }
+  fclose(f);
+
+  if (ok) {
+    ok = verifyInventory(samples);
+  }
+  if (!ok) {
+    _devices = 0;
+    updateBusInfo();
+  }
+  return ok;
+}
+
+/*
+ * an empty inventory is not trusted, searching an empty bus is cheap. The
+ * first and the last device are always among the samples, the reads also
+ * refresh their cached registers
+ */
+bool Dallas::verifyInventory(uint8_t samples) {
+  if (_devices == 0) {
+    return false;
+  }
+
+  OwTransaction t;
+  owReset(t);
+  if (!owRun(t)) {
+    return false;
+  }
+
+  ScratchPad scratchPad;
+  uint8_t checks = MIN(samples, _devices);
+  for (uint8_t i = 0; i < checks; i++) {
+    uint8_t index =
+        (checks == 1) ? 0 : (uint16_t) i * (_devices - 1) / (checks - 1);
+    if (!isConnected(_deviceTable[index].address, scratchPad)) {
+      return false;
+    }
+  }
+  updateBusInfo();
+  return true;
+}
+
+bool Dallas::begin(const char *inventoryPath) {
+  if (loadInventory(inventoryPath)) {
+    return true;
+  }
+  refreshDeviceTable();
+  saveInventory(inventoryPath);
+  return false;
+}
+
+/*
+ * a parasite powered device pulls the read slot low, so the slot only tells
+ * whether there is at least one
+ */
+void Dallas::checkParasite(void) {
+  if (_devices == 0 || readPowerSupply(NULL)) {
+    return;
+  }
+  for (uint8_t i = 0; i < _devices; i++) {
+    _deviceTable[i].parasite = false;
+    _deviceTable[i].parasiteKnown = true;
+  }
+}
+
+Dallas::DeviceInfo *Dallas::findDevice(const uint8_t *deviceAddress) {
+  for (uint8_t i = 0; i < _devices; i++) {
+    if (memcmp(_deviceTable[i].address, deviceAddress,
+               sizeof(DeviceAddress)) == 0) {
+      return &_deviceTable[i];
+    }
+  }
+  return NULL;
+}
+
+Dallas::DeviceInfo *Dallas::addDevice(const uint8_t *deviceAddress) {
+  if (_devices == _deviceTableSize) {
+    if (_deviceTableSize == 255) {
+      return NULL;
+    }
+    uint8_t newSize =
+        (_deviceTableSize == 0) ? 8 : MIN(255, 2 * (int) _deviceTableSize);
+    DeviceInfo *table = new DeviceInfo[newSize];
+    if (_devices > 0) {
+      memcpy(table, _deviceTable, _devices * sizeof(DeviceInfo));
+    }
+    delete[] _deviceTable;
+    _deviceTable = table;
+    _deviceTableSize = newSize;
+  }
+  DeviceInfo *info = &_deviceTable[_devices++];
+  memcpy(info->address, deviceAddress, sizeof(DeviceAddress));
+  info->family = deviceAddress[0];
+  info->resolution = 0;
+  info->parasite = false;
+  info->parasiteKnown = false;
+  info->overdrive = (info->family == DS28EA00MODEL);
+  info->overdriveFailures = 0;
+  info->scratchPadValid = false;
+  info->crcErrors = 0;
+  info->presenceErrors = 0;
+  info->consecutiveErrors = 0;
+  info->quarantineSkips = 0;
+  info->reported = false;
+  return info;
+}
+
+/*
+ * the counters saturate; a device reaching the threshold skips 1 read, each
+ * further failed retry doubles the skipped reads
+ */
+uint8_t Dallas::recordRead(DeviceInfo *info, uint8_t status) {
+  if (info == NULL) {
+    return status;
+  }
+  if (status == DEVICE_READ_OK) {
+    info->consecutiveErrors = 0;
+    info->quarantineSkips = 0;
+    return status;
+  }
+  if (status == DEVICE_READ_CRC_ERROR && info->crcErrors < UINT16_MAX) {
+    info->crcErrors++;
+  } else if (status == DEVICE_READ_NO_PRESENCE &&
+             info->presenceErrors < UINT16_MAX) {
+    info->presenceErrors++;
+  }
+  if (info->consecutiveErrors < UINT8_MAX) {
+    info->consecutiveErrors++;
+  }
+  if (_quarantineThreshold > 0 &&
+      info->consecutiveErrors >= _quarantineThreshold) {
+    uint8_t shift = info->consecutiveErrors - _quarantineThreshold;
+    info->quarantineSkips = 1 << MIN(shift, QUARANTINE_MAX_SHIFT);
+  }
+  return status;
+}
+
+bool Dallas::skipQuarantined(DeviceInfo *info) {
+  if (info == NULL || _quarantineThreshold == 0 ||
+      info->quarantineSkips == 0) {
+    return false;
+  }
+  info->quarantineSkips--;
+  return true;
+}
+
+bool Dallas::isQuarantined(uint8_t index) {
+  return (index < _devices) && (_quarantineThreshold > 0) &&
+         (_deviceTable[index].consecutiveErrors >= _quarantineThreshold);
+}
+
+void Dallas::resetDeviceErrors(void) {
+  for (uint8_t i = 0; i < _devices; i++) {
+    _deviceTable[i].crcErrors = 0;
+    _deviceTable[i].presenceErrors = 0;
+    _deviceTable[i].consecutiveErrors = 0;
+    _deviceTable[i].quarantineSkips = 0;
+  }
+}
+
+void Dallas::cacheScratchPad(DeviceInfo *info, const uint8_t *scratchPad) {
+  info->scratchPadValid = true;
+  info->highAlarm = scratchPad[HIGH_ALARM_TEMP];
+  info->lowAlarm = scratchPad[LOW_ALARM_TEMP];
+  info->configuration = scratchPad[CONFIGURATION];
+  if (info->family != DS18S20MODEL) {
+    uint8_t resolution = configurationToResolution(info->configuration);
+    if (resolution != 0) {
+      info->resolution = resolution;
+    }
+  }
+}
+
+void Dallas::invalidateScratchPadCache(void) {
+  for (uint8_t i = 0; i < _devices; i++) {
+    _deviceTable[i].scratchPadValid = false;
   }
 }
 
@@ -107,20 +709,15 @@ bool Dallas::validFamily(const uint8_t *deviceAddress) {
 }
 
 /*
- * finds an address at a given index on the bus
+ * finds an address at a given index in the device table
  * returns true if the device was found
  */
 bool Dallas::getAddress(uint8_t *deviceAddress, uint8_t index) {
-  uint8_t depth = 0;
-
-  _ow->reset_search();
-
-  while (depth <= index && _ow->search(deviceAddress)) {
-    if (depth == index && validAddress(deviceAddress)) return true;
-    depth++;
+  if (index >= _devices) {
+    return false;
   }
-
-  return false;
+  memcpy(deviceAddress, _deviceTable[index].address, sizeof(DeviceAddress));
+  return true;
 }
 
 /*
@@ -137,17 +734,34 @@ bool Dallas::isConnected(const uint8_t *deviceAddress) {
 // also allows for updating the read scratchpad
 
 bool Dallas::isConnected(const uint8_t *deviceAddress, uint8_t *scratchPad) {
-  bool b = readScratchPad(deviceAddress, scratchPad);
-  return b && (crc8(scratchPad, 8) == scratchPad[SCRATCHPAD_CRC]);
+  BUS_STATS_OP(DALLAS_OP_IS_CONNECTED);
+
+  DeviceInfo *info = findDevice(deviceAddress);
+  uint8_t st = readValidScratchPad(info, deviceAddress, scratchPad, true);
+  if (st != DEVICE_READ_OK) {
+    recordRead(info, st);
+    return false;
+  }
+
+  if (info != NULL) {
+    recordRead(info, DEVICE_READ_OK);
+    cacheScratchPad(info, scratchPad);
+  }
+  return true;
 }
 
 bool Dallas::readScratchPad(const uint8_t *deviceAddress, uint8_t *scratchPad) {
-  // send the reset command and fail fast
-  int b = _ow->reset();
-  if (b == 0) return false;
+  BUS_STATS_OP(DALLAS_OP_READ_SCRATCHPAD);
+
+  return readScratchPadBytes(deviceAddress, scratchPad, true);
+}
 
-  _ow->select(deviceAddress);
-  _ow->write(READSCRATCH);
+bool Dallas::readScratchPadBytes(const uint8_t *deviceAddress,
+                                 uint8_t *scratchPad, bool reset) {
+  OwTransaction t;
+  owReset(t);
+  owSelect(t, deviceAddress);
+  owWrite(t, READSCRATCH);
 
   // Read all registers in a simple loop
   // byte 0: temperature LSB
@@ -162,23 +776,75 @@ bool Dallas::readScratchPad(const uint8_t *deviceAddress, uint8_t *scratchPad) {
   // byte 7: DS18S20: COUNT_PER_C
   //         DS18B20 & DS1822: store for crc
   // byte 8: SCRATCHPAD_CRC
-  _ow->read_bytes(scratchPad, 9);
+  owReadBytes(t, scratchPad, 9);
+  if (reset) {
+    owReset(t);
+  }
 
-  b = _ow->reset();
-  return (b == 1);
+  // fails fast if the first reset finds no device
+  return owRun(t);
+}
+
+bool Dallas::selectsOverdrive(const DeviceInfo *info) {
+  return _overdrive && info != NULL && info->family == DS28EA00MODEL &&
+         info->overdrive && _ow->has_overdrive();
+}
+
+/*
+ * a glitch (missing presence, CRC error) must not drop the overdrive speed of
+ * a device: it is only dropped after OVERDRIVE_MAX_FAILURES consecutive reads
+ * that fail at overdrive speed but not at standard speed
+ */
+uint8_t Dallas::readValidScratchPad(DeviceInfo *info,
+                                    const uint8_t *deviceAddress,
+                                    uint8_t *scratchPad, bool reset) {
+  bool overdrive = selectsOverdrive(info);
+  uint8_t st = DEVICE_READ_OK;
+  for (uint8_t attempt = 0; attempt < (overdrive ? 2 : 1); attempt++) {
+    if (attempt == 1) {
+      info->overdrive = false;  // this read at standard speed
+    }
+    if (!readScratchPadBytes(deviceAddress, scratchPad, reset)) {
+      st = DEVICE_READ_NO_PRESENCE;
+    } else if (crc8(scratchPad, 8) != scratchPad[SCRATCHPAD_CRC]) {
+      st = DEVICE_READ_CRC_ERROR;
+    } else {
+      st = DEVICE_READ_OK;
+      break;
+    }
+  }
+  if (overdrive) {
+    if (info->overdrive) {
+      info->overdriveFailures = 0;  // read at overdrive speed
+    } else {
+      bool failed = (st == DEVICE_READ_OK) &&
+                    (++info->overdriveFailures >= OVERDRIVE_MAX_FAILURES);
+      info->overdrive = !failed;
+    }
+  }
+  return st;
 }
 
 void Dallas::writeScratchPad(const uint8_t *deviceAddress,
                              const uint8_t *scratchPad) {
-  _ow->reset();
-  _ow->select(deviceAddress);
-  _ow->write(WRITESCRATCH);
-  _ow->write(scratchPad[HIGH_ALARM_TEMP]);  // high alarm temp
-  _ow->write(scratchPad[LOW_ALARM_TEMP]);   // low alarm temp
+  BUS_STATS_OP(DALLAS_OP_WRITE_SCRATCHPAD);
+
+  // the device contents are known again after the next validated read
+  DeviceInfo *info = findDevice(deviceAddress);
+  if (info != NULL) {
+    info->scratchPadValid = false;
+  }
+
+  OwTransaction t;
+  owReset(t);
+  owSelect(t, deviceAddress);
+  owWrite(t, WRITESCRATCH);
+  owWrite(t, scratchPad[HIGH_ALARM_TEMP]);  // high alarm temp
+  owWrite(t, scratchPad[LOW_ALARM_TEMP]);   // low alarm temp
 
   // DS1820 and DS18S20 have no configuration register
   if (deviceAddress[0] != DS18S20MODEL) {
-    _ow->write(scratchPad[CONFIGURATION]);
+    owWrite(t, scratchPad[CONFIGURATION]);
   }
 
   //_ow->reset();
@@ -190,19 +856,39 @@ void Dallas::writeScratchPad(const uint8_t *deviceAddress,
   // operation (as specified by datasheet)
 
   // if (parasite) delay(10); // 10ms delay
-  _ow->reset();
+  owReset(t);
+  owRun(t);
 }
 
 bool Dallas::readPowerSupply(const uint8_t *deviceAddress) {
-  bool ret = false;
-  _ow->reset();
-  _ow->select(deviceAddress);
-  _ow->write(READPOWERSUPPLY);
-  if (_ow->read_bit() == 0) {
-    ret = true;
-  }
-  _ow->reset();
-  return ret;
+  BUS_STATS_OP(DALLAS_OP_READ_POWER_SUPPLY);
+
+  OwTransaction t;
+  uint8_t bit = 1;
+  owReset(t);
+  if (deviceAddress == NULL) {
+    owSkip(t);
+  } else {
+    owSelect(t, deviceAddress);
+  }
+  owWrite(t, READPOWERSUPPLY);
+  owReadBit(t, &bit);
+  owReset(t);
+  owRun(t);
+  return (bit == 0);
+}
+
+bool Dallas::isParasite(const uint8_t *deviceAddress) {
+  DeviceInfo *info = findDevice(deviceAddress);
+  if (info != NULL && info->parasiteKnown) {
+    return info->parasite;
+  }
+  bool parasite = readPowerSupply(deviceAddress);
+  if (info != NULL) {
+    info->parasite = parasite;
+    info->parasiteKnown = true;
+  }
+  return parasite;
 }
 
 /*
@@ -210,23 +896,49 @@ bool Dallas::readPowerSupply(const uint8_t *deviceAddress) {
  * returns 0 if device not found
  */
 uint8_t Dallas::getResolution(const uint8_t *deviceAddress) {
+  BUS_STATS_OP(DALLAS_OP_GET_RESOLUTION);
+
   // DS1820 and DS18S20 have no resolution configuration register
   if (deviceAddress[0] == DS18S20MODEL) {
     return 12;
   }
 
+  DeviceInfo *info = findDevice(deviceAddress);
+  if (info != NULL && info->scratchPadValid) {
+    return configurationToResolution(info->configuration);
+  }
+
   ScratchPad scratchPad;
   if (isConnected(deviceAddress, scratchPad)) {
-    switch (scratchPad[CONFIGURATION]) {
-      case TEMP_12_BIT:
-        return 12;
-      case TEMP_11_BIT:
-        return 11;
-      case TEMP_10_BIT:
-        return 10;
-      case TEMP_9_BIT:
-        return 9;
-    }
+    return configurationToResolution(scratchPad[CONFIGURATION]);
+  }
+  return 0;
+}
+
+uint8_t Dallas::resolutionToConfiguration(uint8_t resolution) {
+  switch (resolution) {
+    case 12:
+      return TEMP_12_BIT;
+    case 11:
+      return TEMP_11_BIT;
+    case 10:
+      return TEMP_10_BIT;
+    case 9:
+    default:
+      return TEMP_9_BIT;
+  }
+}
+
+uint8_t Dallas::configurationToResolution(uint8_t configuration) {
+  switch (configuration) {
+    case TEMP_12_BIT:
+      return 12;
+    case TEMP_11_BIT:
+      return 11;
+    case TEMP_10_BIT:
+      return 10;
+    case TEMP_9_BIT:
+      return 9;
   }
   return 0;
 }
@@ -236,13 +948,90 @@ uint8_t Dallas::getResolution(const uint8_t *deviceAddress) {
  * if new resolution is out of range, it is constrained.
  */
 void Dallas::setResolution(uint8_t newResolution) {
+  setResolution(newResolution, false, false);
+}
+
+/*
+ * a write scratchpad always sets the alarm registers too, so the resolution
+ * is broadcast only when they are known and equal on all devices (DS18S20
+ * included, they take the alarm registers and ignore the configuration).
+ * Otherwise every configurable device is written on its own
+ */
+bool Dallas::setResolution(uint8_t newResolution, bool copyToEeprom,
+                           bool verify) {
+  BUS_STATS_OP(DALLAS_OP_SET_RESOLUTION);
+
   _bitResolution =
       (newResolution < 9) ? 9 : (newResolution > 12 ? 12 : newResolution);
-  DeviceAddress deviceAddress;
-  for (int i = 0; i < _devices; i++) {
-    getAddress(deviceAddress, i);
-    setResolution(deviceAddress, _bitResolution, true);
+
+  bool broadcast = (_devices > 0);
+  bool changed = false;
+  for (uint8_t i = 0; i < _devices; i++) {
+    DeviceInfo *info = &_deviceTable[i];
+    if (!info->scratchPadValid ||
+        info->highAlarm != _deviceTable[0].highAlarm ||
+        info->lowAlarm != _deviceTable[0].lowAlarm) {
+      broadcast = false;
+    }
+    if (info->family != DS18S20MODEL && info->resolution != _bitResolution) {
+      changed = true;
+    }
   }
+
+  uint8_t configuration = resolutionToConfiguration(_bitResolution);
+  if (!broadcast) {
+    for (uint8_t i = 0; i < _devices; i++) {
+      setResolution(_deviceTable[i].address, _bitResolution, true);
+    }
+  } else if (changed) {
+    OwTransaction t;
+    owReset(t);
+    owSkip(t);
+    owWrite(t, WRITESCRATCH);
+    owWrite(t, _deviceTable[0].highAlarm);
+    owWrite(t, _deviceTable[0].lowAlarm);
+    owWrite(t, configuration);
+    owReset(t);
+    owRun(t);
+    // all the registers written are known, the caches stay valid
+    for (uint8_t i = 0; i < _devices; i++) {
+      if (_deviceTable[i].family != DS18S20MODEL) {
+        _deviceTable[i].configuration = configuration;
+        _deviceTable[i].resolution = _bitResolution;
+      }
+    }
+  }
+
+  if (copyToEeprom) {
+    OwTransaction t;
+    owReset(t);
+    owSkip(t);
+    owWrite(t, COPYSCRATCH, _parasite);
+    owRun(t);
+    mgos_usleep(COPY_SCRATCH_MICROS);
+    OwTransaction done;
+    owReset(done);
+    owRun(done);
+  }
+
+  if (!verify) {
+    return true;
+  }
+
+  // the reads also cache the registers and the resolution actually set
+  bool ok = true;
+  for (uint8_t i = 0; i < _devices; i++) {
+    DeviceInfo *info = &_deviceTable[i];
+    ScratchPad scratchPad;
+    if (!isConnected(info->address, scratchPad) ||
+        (info->family != DS18S20MODEL && info->resolution != _bitResolution)) {
+      ok = false;
+    }
+  }
+  if (!ok) {
+    updateBusInfo();
+  }
+  return ok;
 }
 
 /*
@@ -251,6 +1040,8 @@ void Dallas::setResolution(uint8_t newResolution) {
  */
 bool Dallas::setResolution(const uint8_t *deviceAddress, uint8_t newResolution,
                            bool skipGlobalBitResolutionCalculation) {
+  BUS_STATS_OP(DALLAS_OP_SET_RESOLUTION);
+
   /*
    * ensure same behavior as setResolution(uint8_t newResolution)
    */
@@ -264,36 +1055,34 @@ bool Dallas::setResolution(const uint8_t *deviceAddress, uint8_t newResolution,
     return true;
   }
 
+  /*
+   * only the alarm and configuration registers are written, use the cached
+   * ones if available
+   */
   ScratchPad scratchPad;
-  if (isConnected(deviceAddress, scratchPad)) {
+  DeviceInfo *info = findDevice(deviceAddress);
+  bool known = (info != NULL && info->scratchPadValid);
+  if (known) {
+    scratchPad[HIGH_ALARM_TEMP] = info->highAlarm;
+    scratchPad[LOW_ALARM_TEMP] = info->lowAlarm;
+    scratchPad[CONFIGURATION] = info->configuration;
+  }
+  if (known || isConnected(deviceAddress, scratchPad)) {
     // DS1820 and DS18S20 have no resolution configuration register
     if (deviceAddress[0] != DS18S20MODEL) {
-      switch (newResolution) {
-        case 12:
-          scratchPad[CONFIGURATION] = TEMP_12_BIT;
-          break;
-        case 11:
-          scratchPad[CONFIGURATION] = TEMP_11_BIT;
-          break;
-        case 10:
-          scratchPad[CONFIGURATION] = TEMP_10_BIT;
-          break;
-        case 9:
-        default:
-          scratchPad[CONFIGURATION] = TEMP_9_BIT;
-          break;
-      }
+      scratchPad[CONFIGURATION] = resolutionToConfiguration(newResolution);
       writeScratchPad(deviceAddress, scratchPad);
+      if (info != NULL) {
+        info->resolution = newResolution;
+      }
 
       // without calculation we can always set it to max
       _bitResolution = MAX(_bitResolution, newResolution);
       if (!skipGlobalBitResolutionCalculation &&
           (_bitResolution > newResolution)) {
         _bitResolution = newResolution;
-        DeviceAddress deviceAddr;
         for (int i = 0; i < _devices; i++) {
-          getAddress(deviceAddr, i);
-          _bitResolution = MAX(_bitResolution, getResolution(deviceAddr));
+          _bitResolution = MAX(_bitResolution, _deviceTable[i].resolution);
         }
       }
     }
@@ -303,13 +1092,134 @@ bool Dallas::setResolution(const uint8_t *deviceAddress, uint8_t newResolution,
   return false;
 }
 
+/*
+ * returns the alarm thresholds of a device from the cached or read scratchpad
+ */
+bool Dallas::getAlarmThresholds(const uint8_t *deviceAddress, int8_t *low,
+                                int8_t *high) {
+  DeviceInfo *info = findDevice(deviceAddress);
+  if (info != NULL && info->scratchPadValid) {
+    *low = (int8_t) info->lowAlarm;
+    *high = (int8_t) info->highAlarm;
+    return true;
+  }
+
+  ScratchPad scratchPad;
+  if (isConnected(deviceAddress, scratchPad)) {
+    *low = (int8_t) scratchPad[LOW_ALARM_TEMP];
+    *high = (int8_t) scratchPad[HIGH_ALARM_TEMP];
+    return true;
+  }
+  return false;
+}
+
+/*
+ * set the alarm thresholds of all devices
+ * the configuration register is written too, so a single broadcast write is
+ * only possible if all the devices use the same one
+ */
+void Dallas::setAlarmThresholds(int8_t low, int8_t high) {
+  BUS_STATS_OP(DALLAS_OP_SET_ALARM);
+
+  bool broadcast = (_devices > 0);
+  uint8_t configuration = 0;
+  for (uint8_t i = 0; broadcast && i < _devices; i++) {
+    DeviceInfo *info = &_deviceTable[i];
+    // DS1820 and DS18S20 have no configuration register
+    if (info->family == DS18S20MODEL) {
+      continue;
+    }
+    if (!info->scratchPadValid ||
+        (configuration != 0 && configuration != info->configuration)) {
+      broadcast = false;
+    }
+    configuration = info->configuration;
+  }
+
+  if (!broadcast) {
+    for (uint8_t i = 0; i < _devices; i++) {
+      setAlarmThresholds(_deviceTable[i].address, low, high);
+    }
+    return;
+  }
+
+  OwTransaction t;
+  owReset(t);
+  owSkip(t);
+  owWrite(t, WRITESCRATCH);
+  owWrite(t, (uint8_t) high);
+  owWrite(t, (uint8_t) low);
+  // ignored by DS1820 and DS18S20
+  if (configuration != 0) {
+    owWrite(t, configuration);
+  }
+  owReset(t);
+  owRun(t);
+  invalidateScratchPadCache();
+}
+
+bool Dallas::setAlarmThresholds(const uint8_t *deviceAddress, int8_t low,
+                                int8_t high) {
+  BUS_STATS_OP(DALLAS_OP_SET_ALARM);
+
+  ScratchPad scratchPad;
+  DeviceInfo *info = findDevice(deviceAddress);
+  if (info != NULL && info->scratchPadValid) {
+    scratchPad[CONFIGURATION] = info->configuration;
+  } else if (!isConnected(deviceAddress, scratchPad)) {
+    return false;
+  }
+  scratchPad[HIGH_ALARM_TEMP] = (uint8_t) high;
+  scratchPad[LOW_ALARM_TEMP] = (uint8_t) low;
+  writeScratchPad(deviceAddress, scratchPad);
+  return true;
+}
+
+void Dallas::resetAlarmSearch(void) {
+  _ow->reset_search();
+}
+
+bool Dallas::alarmSearch(uint8_t *deviceAddress) {
+  BUS_STATS_OP(DALLAS_OP_ALARM_SEARCH);
+
+  while (owSearch(deviceAddress, false)) {
+    if (validAddress(deviceAddress)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+/*
+ * searches all the devices with an alarm condition and returns their device
+ * table indexes
+ */
+uint8_t Dallas::getAlarmDevices(uint8_t *indexes, uint8_t n) {
+  BUS_STATS_OP(DALLAS_OP_ALARM_SEARCH);
+
+  DeviceAddress deviceAddress;
+  uint8_t count = 0;
+  resetAlarmSearch();
+  while (alarmSearch(deviceAddress)) {
+    DeviceInfo *info = findDevice(deviceAddress);
+    if (info == NULL) {
+      continue;  // not enumerated
+    }
+    if (count < n) {
+      indexes[count] = info - _deviceTable;
+    }
+    count++;
+  }
+  return count;
+}
+
 /*
  * sends command for all devices on the bus to perform a temperature conversion
  */
 void Dallas::requestTemperatures() {
-  _ow->reset();
-  _ow->skip();
-  _ow->write(STARTCONVO, _parasite);
+  BUS_STATS_OP(DALLAS_OP_REQUEST_TEMPERATURES);
+
+  startConversion();
 
   // ASYNC mode?
   if (!_waitForConversion) {
@@ -318,20 +1228,175 @@ void Dallas::requestTemperatures() {
   blockTillConversionComplete(_bitResolution);
 }
 
+/*
+ * sends command for all devices on the bus to perform a temperature conversion
+ * and calls cb from a timer when the conversion is complete
+ */
+bool Dallas::requestTemperaturesAsync(ConversionCallback cb, void *arg) {
+  BUS_STATS_OP(DALLAS_OP_REQUEST_TEMPERATURES);
+
+  if (isConversionPending()) {
+    return false;
+  }
+
+  startConversion();
+
+  _conversionCb = cb;
+  _conversionCbArg = arg;
+  uint32_t delms = millisToWaitForConversion(_bitResolution);
+  _conversionDeadline = (uint64_t)(mgos_uptime() * 1000 * 1000) + 1000 * delms;
+  if (_checkForConversion && !_parasite) {
+    delms = CONVERSION_POLL_MS;
+  }
+  _conversionTimer = mgos_set_timer(delms, 0, conversionTimerCb, this);
+  return isConversionPending();
+}
+
+void Dallas::cancelConversion(void) {
+  if (isConversionPending()) {
+    mgos_clear_timer(_conversionTimer);
+    _conversionTimer = MGOS_INVALID_TIMER_ID;
+  }
+}
+
+/*
+ * checks an asynchronous conversion and calls the user callback when it is
+ * complete, otherwise re-arms the timer
+ */
+void Dallas::conversionTimerCb(void *arg) {
+  Dallas *dallas = (Dallas *) arg;
+  uint64_t now = (uint64_t)(mgos_uptime() * 1000 * 1000);
+  if (dallas->_checkForConversion && !dallas->_parasite &&
+      now < dallas->_conversionDeadline && !dallas->isConversionComplete()) {
+    dallas->_conversionTimer =
+        mgos_set_timer(CONVERSION_POLL_MS, 0, conversionTimerCb, dallas);
+    if (dallas->isConversionPending()) {
+      return;
+    }
+  }
+
+  // the callback may start a new conversion
+  dallas->_conversionTimer = MGOS_INVALID_TIMER_ID;
+  if (dallas->_conversionCb != NULL) {
+    dallas->_conversionCb(dallas, dallas->_conversionCbArg);
+  }
+}
+
+/*
+ * sends command for all devices on the bus to perform a temperature conversion
+ * and reads every resolution group as soon as it is ready
+ */
+bool Dallas::readAllStagedAsync(int16_t *raw, uint8_t *status, uint8_t n,
+                                StageCallback cb, void *arg) {
+  BUS_STATS_OP(DALLAS_OP_REQUEST_TEMPERATURES);
+
+  // nothing to read: neither the bus nor the pending state is touched
+  if (isConversionPending() || n == 0 || _devices == 0) {
+    return false;
+  }
+
+  startConversion();
+
+  _conversionStart = (uint64_t)(mgos_uptime() * 1000 * 1000);
+  _stageCb = cb;
+  _conversionCbArg = arg;
+  _stageRaw = raw;
+  _stageStatus = status;
+  _stageCount = MIN(n, _devices);
+  _stageResolution = 0;
+  // read slots tell the end of the conversion only until the first read
+  _stagePoll = _checkForConversion && !_parasite;
+  return scheduleStage();
+}
+
+uint8_t Dallas::nextStageResolution(uint8_t resolution) {
+  uint8_t next = 0;
+  for (uint8_t i = 0; i < _stageCount; i++) {
+    // unknown resolution: wait for the worst case
+    uint8_t r = _deviceTable[i].resolution ? _deviceTable[i].resolution : 12;
+    if (r > resolution && (next == 0 || r < next)) {
+      next = r;
+    }
+  }
+  return next;
+}
+
+bool Dallas::scheduleStage(void) {
+  uint8_t next = nextStageResolution(_stageResolution);
+  if (next == 0) {
+    return false;
+  }
+
+  _stageResolution = next;
+  uint8_t wait = next;
+  if (_parasite) {
+    // the strong pullup must stay on: one wait for the highest resolution
+    for (uint8_t r = next; r != 0; r = nextStageResolution(r)) {
+      wait = r;
+    }
+  }
+  uint64_t due = _conversionStart + 1000 * millisToWaitForConversion(wait);
+  uint64_t now = (uint64_t)(mgos_uptime() * 1000 * 1000);
+  uint32_t delms = (due > now) ? (due - now + 999) / 1000 : 0;
+  _conversionTimer = mgos_set_timer(delms, 0, stageTimerCb, this);
+  return isConversionPending();
+}
+
+/*
+ * reads the group whose conversion time has elapsed, or all the remaining
+ * groups if the bus reports that every conversion is complete. The bus only
+ * answers this right after Convert T: once a scratchpad has been read a read
+ * slot returns 1, so later groups wait for their datasheet time.
+ * In parasite power mode the single stage reads every group.
+ */
+void Dallas::stageTimerCb(void *arg) {
+  Dallas *dallas = (Dallas *) arg;
+  dallas->_conversionTimer = MGOS_INVALID_TIMER_ID;
+
+  bool complete = dallas->_parasite ||
+                  (dallas->_stagePoll && dallas->isConversionComplete());
+  dallas->_stagePoll = false;
+  for (;;) {
+    uint8_t resolution = dallas->_stageResolution;
+    dallas->readResultsByResolution(resolution, dallas->_stageRaw,
+                                    dallas->_stageStatus, dallas->_stageCount);
+    if (dallas->_stageCb != NULL) {
+      dallas->_stageCb(dallas, resolution, dallas->_conversionCbArg);
+    }
+    // the callback started a new conversion
+    if (dallas->isConversionPending()) {
+      return;
+    }
+    if (!complete) {
+      break;
+    }
+    dallas->_stageResolution = dallas->nextStageResolution(resolution);
+    if (dallas->_stageResolution == 0) {
+      return;
+    }
+  }
+
+  dallas->scheduleStage();
+}
+
 /*
  * sends command for one device to perform a temperature by address
  * returns FALSE if device is disconnected
  * returns TRUE  otherwise
  */
 bool Dallas::requestTemperaturesByAddress(const uint8_t *deviceAddress) {
+  BUS_STATS_OP(DALLAS_OP_REQUEST_TEMPERATURES);
+
   uint8_t bitResolution = getResolution(deviceAddress);
   if (bitResolution == 0) {
     return false;  // Device disconnected
   }
 
-  _ow->reset();
-  _ow->select(deviceAddress);
-  _ow->write(STARTCONVO, _parasite);
+  OwTransaction t;
+  owReset(t);
+  owSelect(t, deviceAddress);
+  owWrite(t, STARTCONVO, _parasite);
+  owRun(t);
 
   // ASYNC mode?
   if (!_waitForConversion) {
@@ -346,10 +1411,11 @@ bool Dallas::requestTemperaturesByAddress(const uint8_t *deviceAddress) {
  * sends command for one device to perform a temp conversion by index
  */
 bool Dallas::requestTemperaturesByIndex(uint8_t deviceIndex) {
-  DeviceAddress deviceAddress;
-  getAddress(deviceAddress, deviceIndex);
+  if (deviceIndex >= _devices) {
+    return false;
+  }
 
-  return requestTemperaturesByAddress(deviceAddress);
+  return requestTemperaturesByAddress(_deviceTable[deviceIndex].address);
 }
 
 /*
@@ -360,13 +1426,159 @@ bool Dallas::requestTemperaturesByIndex(uint8_t deviceIndex) {
  * operating range of the device
  */
 int16_t Dallas::getTemp(const uint8_t *deviceAddress) {
+  BUS_STATS_OP(DALLAS_OP_GET_TEMP);
+
+  DeviceInfo *info = findDevice(deviceAddress);
+  if (skipQuarantined(info)) {
+    return DEVICE_DISCONNECTED_RAW;
+  }
+
+  int16_t raw;
+  if (_shortRead && deviceAddress[0] != DS18S20MODEL) {
+    uint8_t st = readTemperatureShort(deviceAddress, &raw, true);
+    if (st == DEVICE_READ_OK) {
+      recordRead(info, st);
+      recordSample(info, sampleTime(), raw);
+      return raw;
+    }
+    if (st == DEVICE_READ_NO_PRESENCE) {
+      recordRead(info, st);
+      return DEVICE_DISCONNECTED_RAW;
+    }
+  }
+
   ScratchPad scratchPad;
   if (isConnected(deviceAddress, scratchPad)) {
-    return calculateTemperature(deviceAddress, scratchPad);
+    raw = calculateTemperature(deviceAddress, scratchPad);
+    recordSample(info, sampleTime(), raw);
+    return raw;
   }
   return DEVICE_DISCONNECTED_RAW;
 }
 
+/*
+ * time of the samples recorded by a read sweep, milliseconds since boot
+ */
+uint32_t Dallas::sampleTime(void) {
+  bool used = (_sampleStore != NULL || _changeCb != NULL);
+  return used ? (uint32_t)(mgos_uptime() * 1000) : 0;
+}
+
+/*
+ * the first value of a device is always reported, then the values moving
+ * more than the deadband away from the last reported one, or any value once
+ * the device has been silent for maxSilence
+ */
+void Dallas::recordSample(DeviceInfo *info, uint32_t now, int16_t raw) {
+  if (info == NULL) {
+    return;
+  }
+  if (_sampleStore != NULL) {
+    _sampleStore->add(info->address, now, raw);
+  }
+  if (_changeCb == NULL) {
+    return;
+  }
+  int32_t delta = (int32_t) raw - info->reportedRaw;
+  if (info->reported && (delta < 0 ? -delta : delta) <= _changeDeadband &&
+      (_changeMaxSilence == 0 ||
+       now - info->reportedTime < _changeMaxSilence)) {
+    return;
+  }
+  info->reported = true;
+  info->reportedRaw = raw;
+  info->reportedTime = now;
+  _changeCb(this, info->address, raw, _changeCbArg);
+}
+
+void Dallas::setChangeReporting(uint16_t deadband, uint32_t maxSilence,
+                                ChangeCallback cb, void *arg) {
+  _changeDeadband = deadband;
+  _changeMaxSilence = maxSilence;
+  _changeCb = cb;
+  _changeCbArg = arg;
+  for (uint8_t i = 0; i < _devices; i++) {
+    _deviceTable[i].reported = false;
+  }
+}
+
+/*
+ * converts and reads every device in the device table
+ * returns the number of devices read successfully
+ */
+uint8_t Dallas::readAll(int16_t *raw, uint8_t *status, uint8_t n) {
+  BUS_STATS_OP(DALLAS_OP_READ_ALL);
+
+  startConversion();
+  blockTillConversionComplete(_bitResolution);
+
+  return readAllResults(raw, status, n);
+}
+
+/*
+ * reads every device in the device table in one sweep, a reset between two
+ * devices also terminates the previous scratchpad read
+ * returns the number of devices read successfully
+ */
+uint8_t Dallas::readAllResults(int16_t *raw, uint8_t *status, uint8_t n) {
+  BUS_STATS_OP(DALLAS_OP_READ_ALL);
+
+  uint8_t count = MIN(n, _devices);
+  uint8_t ok = 0;
+  uint32_t now = sampleTime();
+  for (uint8_t i = 0; i < count; i++) {
+    uint8_t st = readTemperature(&_deviceTable[i], &raw[i]);
+    if (st == DEVICE_READ_OK) {
+      ok++;
+      recordSample(&_deviceTable[i], now, raw[i]);
+    }
+    if (status != NULL) {
+      status[i] = st;
+    }
+  }
+  if (count > 0) {
+    OwTransaction t;
+    owReset(t);
+    owRun(t);
+  }
+  return ok;
+}
+
+/*
+ * reads the devices of the device table with the given resolution
+ * returns the number of devices read successfully
+ */
+uint8_t Dallas::readResultsByResolution(uint8_t resolution, int16_t *raw,
+                                        uint8_t *status, uint8_t n) {
+  BUS_STATS_OP(DALLAS_OP_READ_ALL);
+
+  uint8_t count = MIN(n, _devices);
+  uint8_t ok = 0;
+  bool read = false;
+  uint32_t now = sampleTime();
+  for (uint8_t i = 0; i < count; i++) {
+    DeviceInfo *info = &_deviceTable[i];
+    if ((info->resolution ? info->resolution : 12) != resolution) {
+      continue;
+    }
+    uint8_t st = readTemperature(info, &raw[i]);
+    if (st == DEVICE_READ_OK) {
+      ok++;
+      recordSample(info, now, raw[i]);
+    }
+    if (status != NULL) {
+      status[i] = st;
+    }
+    read = true;
+  }
+  if (read) {
+    OwTransaction t;
+    owReset(t);
+    owRun(t);
+  }
+  return ok;
+}
+
 /*
  * returns temperature in degrees C or DEVICE_DISCONNECTED_C if the
  * device's scratch pad cannot be read successfully.
@@ -393,31 +1605,68 @@ float Dallas::getTempF(const uint8_t *deviceAddress) {
  * Fetch temperature for device index
  */
 float Dallas::getTempCByIndex(uint8_t deviceIndex) {
-  DeviceAddress deviceAddress;
-  if (!getAddress(deviceAddress, deviceIndex)) {
+  if (deviceIndex >= _devices) {
     return DEVICE_DISCONNECTED_C;
   }
 
-  return getTempC((uint8_t *) deviceAddress);
+  return getTempC(_deviceTable[deviceIndex].address);
 }
 
 /*
  * Fetch temperature for device index
  */
 float Dallas::getTempFByIndex(uint8_t deviceIndex) {
-  DeviceAddress deviceAddress;
-  if (!getAddress(deviceAddress, deviceIndex)) {
+  if (deviceIndex >= _devices) {
     return DEVICE_DISCONNECTED_F;
   }
 
-  return getTempF((uint8_t *) deviceAddress);
+  return getTempF(_deviceTable[deviceIndex].address);
 }
 
 bool Dallas::isConversionComplete() {
-  uint8_t b = _ow->read_bit();
+  BUS_STATS_OP(DALLAS_OP_CONVERSION_CHECK);
+
+  OwTransaction t;
+  uint8_t b = 0;
+  owReadBit(t, &b);
+  owRun(t);
   return (b == 1);
 }
 
+/*
+ * the reset ends the scratchpad read after the temperature bytes, without CRC
+ * the value is accepted only if it is in the measurement range and not the
+ * power-on value. The bytes of a device that left the bus read all ones, the
+ * other devices still answer the resets: a valid -0.0625 C is read again in
+ * full like a missing device
+ */
+uint8_t Dallas::readTemperatureShort(const uint8_t *deviceAddress,
+                                     int16_t *raw, bool reset) {
+  *raw = DEVICE_DISCONNECTED_RAW;
+
+  ScratchPad scratchPad;
+  OwTransaction t;
+  owReset(t);
+  owSelect(t, deviceAddress);
+  owWrite(t, READSCRATCH);
+  owReadBytes(t, scratchPad, 2);
+  if (reset) {
+    owReset(t);
+  }
+  if (!owRun(t)) {
+    return DEVICE_READ_NO_PRESENCE;
+  }
+
+  bool ones = (scratchPad[TEMP_LSB] == 0xFF && scratchPad[TEMP_MSB] == 0xFF);
+  int16_t value = (int16_t)((scratchPad[TEMP_MSB] << 8) | scratchPad[TEMP_LSB]);
+  if (ones || value == POWER_ON_TEMP || value < MIN_TEMP_REGISTER ||
+      value > MAX_TEMP_REGISTER) {
+    return DEVICE_READ_CRC_ERROR;
+  }
+  *raw = calculateTemperature(deviceAddress, scratchPad);
+  return DEVICE_READ_OK;
+}
+
 /*
  * reads scratchpad and returns fixed-point temperature, scaling factor 2^-7
  */
@@ -456,18 +1705,63 @@ int16_t Dallas::calculateTemperature(const uint8_t *deviceAddress,
   return fpTemperature;
 }
 
+void Dallas::startConversion(void) {
+  BUS_STATS_OP(DALLAS_OP_REQUEST_TEMPERATURES);
+
+  bool overdrive = _overdrive && _devices > 0 && _ow->has_overdrive();
+  for (uint8_t i = 0; overdrive && i < _devices; i++) {
+    overdrive = _deviceTable[i].overdrive;
+  }
+
+  OwTransaction t;
+  owReset(t);
+  if (overdrive) {
+    owOverdriveSkip(t);
+  } else {
+    owSkip(t);
+  }
+  owWrite(t, STARTCONVO, _parasite);
+  owRun(t);
+}
+
+uint8_t Dallas::readTemperature(DeviceInfo *info, int16_t *raw) {
+  *raw = DEVICE_DISCONNECTED_RAW;
+  if (skipQuarantined(info)) {
+    return DEVICE_READ_QUARANTINED;
+  }
+  if (_shortRead && info->family != DS18S20MODEL) {
+    uint8_t st = readTemperatureShort(info->address, raw, false);
+    if (st != DEVICE_READ_CRC_ERROR) {
+      return recordRead(info, st);
+    }
+  }
+
+  ScratchPad scratchPad;
+  uint8_t st = readValidScratchPad(info, info->address, scratchPad, false);
+  if (st != DEVICE_READ_OK) {
+    return recordRead(info, st);
+  }
+
+  cacheScratchPad(info, scratchPad);
+  *raw = calculateTemperature(info->address, scratchPad);
+  return recordRead(info, DEVICE_READ_OK);
+}
+
 /*
  * Continue to check if the IC has responded with a temperature
  */
+/*
+ * polls the bus every CONVERSION_POLL_MS until the conversion completes or
+ * its datasheet time has passed, parasite powered devices cannot answer
+ */
 void Dallas::blockTillConversionComplete(uint8_t bitResolution) {
-  uint32_t delms = 1000 * millisToWaitForConversion(bitResolution);
-  if (_checkForConversion && !_parasite) {
-    uint64_t now = (uint64_t)(mgos_uptime() * 1000 * 1000);
-    while (!isConversionComplete() &&
-           ((uint64_t)(mgos_uptime() * 1000 * 1000) - delms < now))
-      ;
-  } else {
-    mgos_usleep(delms);
+  uint64_t now = (uint64_t)(mgos_uptime() * 1000 * 1000);
+  uint64_t deadline =
+      now + 1000 * (uint64_t) millisToWaitForConversion(bitResolution);
+  bool poll = _checkForConversion && !_parasite;
+  while (now < deadline && !(poll && isConversionComplete())) {
+    mgos_usleep(MIN(deadline - now, (uint64_t) 1000 * CONVERSION_POLL_MS));
+    now = (uint64_t)(mgos_uptime() * 1000 * 1000);
   }
 }
 
@@ -488,6 +1782,25 @@ int16_t Dallas::millisToWaitForConversion(uint8_t bitResolution) {
   }
 }
 
+bool Dallas::getBusStats(uint8_t op, DallasBusStats *stats) {
+#if DALLAS_BUS_STATS
+  if (op < DALLAS_OP_COUNT) {
+    *stats = _busStats[op];
+    return true;
+  }
+#else
+  (void) op;
+  (void) stats;
+#endif
+  return false;
+}
+
+void Dallas::resetBusStats(void) {
+#if DALLAS_BUS_STATS
+  memset(_busStats, 0, sizeof(_busStats));
+#endif
+}
+
 /*
  * Convert from Celsius to Fahrenheit
  */
@@ -526,6 +1839,62 @@ float Dallas::rawToFahrenheit(int16_t raw) {
   return ((float) raw * 1.8 / 128.0) + 32.0;
 }
 
+/*
+ * num / den rounded to nearest, halves away from zero like round(), den > 0
+ */
+static inline int32_t roundedDiv(int32_t num, int32_t den) {
+  return (num >= 0) ? (num + den / 2) / den : -((-num + den / 2) / den);
+}
+
+/*
+ * 1/100 C = RAW * 100 / 128 = RAW * 25 / 32
+ */
+int32_t Dallas::rawToCentiCelsius(int16_t raw) {
+  if (raw <= DEVICE_DISCONNECTED_RAW) {
+    return DEVICE_DISCONNECTED_C * 100;
+  }
+  return roundedDiv((int32_t) raw * 25, 32);
+}
+
+/*
+ * 1/100 F = RAW * 180 / 128 + 3200 = (RAW * 45 + 3200 * 32) / 32
+ */
+int32_t Dallas::rawToCentiFahrenheit(int16_t raw) {
+  if (raw <= DEVICE_DISCONNECTED_RAW) {
+    return DEVICE_DISCONNECTED_F * 100;
+  }
+  return roundedDiv((int32_t) raw * 45 + 3200 * 32, 32);
+}
+
+/*
+ * 1/1000 C = RAW * 1000 / 128 = RAW * 125 / 16
+ */
+int32_t Dallas::rawToMilliCelsius(int16_t raw) {
+  if (raw <= DEVICE_DISCONNECTED_RAW) {
+    return DEVICE_DISCONNECTED_C * 1000;
+  }
+  return roundedDiv((int32_t) raw * 125, 16);
+}
+
+void Dallas::rawToCentiCelsius(const int16_t *raw, int32_t *out, uint8_t n) {
+  for (uint8_t i = 0; i < n; i++) {
+    out[i] = rawToCentiCelsius(raw[i]);
+  }
+}
+
+void Dallas::rawToCentiFahrenheit(const int16_t *raw, int32_t *out,
+                                  uint8_t n) {
+  for (uint8_t i = 0; i < n; i++) {
+    out[i] = rawToCentiFahrenheit(raw[i]);
+  }
+}
+
+void Dallas::rawToMilliCelsius(const int16_t *raw, int32_t *out, uint8_t n) {
+  for (uint8_t i = 0; i < n; i++) {
+    out[i] = rawToMilliCelsius(raw[i]);
+  }
+}
+
 // This table comes from Dallas sample code where it is freely reusable,
 // though Copyright (C) 2000 Dallas Semiconductor Corporation
 static const uint8_t crc_table[] = {
@@ -0,0 +1,155 @@
+#include <mgos.h>
+#include "DallasBusGroup.h"
+
+// Interval between two checks of a conversion
+#define CONVERSION_POLL_MS 10
+
+DallasBusGroup::DallasBusGroup()
+    : _count(0),
+      _timer(MGOS_INVALID_TIMER_ID),
+      _cb(NULL),
+      _cbArg(NULL),
+      _raw(NULL),
+      _status(NULL),
+      _n(0),
+      _deadline(0) {
+}
+
+DallasBusGroup::~DallasBusGroup() {
+  cancelRead();
+}
+
+bool DallasBusGroup::addBus(Dallas *dallas) {
+  if (_count == DALLAS_BUS_GROUP_SIZE || dallas == NULL) {
+    return false;
+  }
+  _buses[_count++] = dallas;
+  return true;
+}
+
+uint16_t DallasBusGroup::getDeviceCount(void) {
+  uint16_t devices = 0;
+  for (uint8_t i = 0; i < _count; i++) {
+    devices += _buses[i]->getDeviceCount();
+  }
+  return devices;
+}
+
+void DallasBusGroup::startConversion(void) {
+  for (uint8_t i = 0; i < _count; i++) {
+    _buses[i]->startConversion();
+  }
+}
+
+uint16_t DallasBusGroup::millisToWaitForConversion(void) {
+  uint16_t delms = 0;
+  for (uint8_t i = 0; i < _count; i++) {
+    Dallas *dallas = _buses[i];
+    delms = MAX(delms,
+                dallas->millisToWaitForConversion(dallas->getResolution()));
+  }
+  return delms;
+}
+
+/*
+ * converts on all the buses, waits once and reads every bus
+ */
+uint16_t DallasBusGroup::readAll(int16_t *raw, uint8_t *status, uint16_t n) {
+  startConversion();
+
+  uint64_t now = (uint64_t)(mgos_uptime() * 1000 * 1000);
+  uint64_t deadline = now + 1000 * (uint64_t) millisToWaitForConversion();
+  bool poll = canCheckForConversion();
+  while (now < deadline && !(poll && isConversionComplete())) {
+    mgos_usleep(MIN(deadline - now, (uint64_t) 1000 * CONVERSION_POLL_MS));
+    now = (uint64_t)(mgos_uptime() * 1000 * 1000);
+  }
+
+  return readAllResults(raw, status, n);
+}
+
+bool DallasBusGroup::readAllAsync(int16_t *raw, uint8_t *status, uint16_t n,
+                                  ReadCallback cb, void *arg) {
+  if (isReadPending()) {
+    return false;
+  }
+
+  startConversion();
+
+  _cb = cb;
+  _cbArg = arg;
+  _raw = raw;
+  _status = status;
+  _n = n;
+  uint32_t delms = millisToWaitForConversion();
+  _deadline = (uint64_t)(mgos_uptime() * 1000 * 1000) + 1000 * delms;
+  if (canCheckForConversion()) {
+    delms = CONVERSION_POLL_MS;
+  }
+  _timer = mgos_set_timer(delms, 0, timerCb, this);
+  return isReadPending();
+}
+
+void DallasBusGroup::cancelRead(void) {
+  if (isReadPending()) {
+    mgos_clear_timer(_timer);
+    _timer = MGOS_INVALID_TIMER_ID;
+  }
+}
+
+bool DallasBusGroup::canCheckForConversion(void) {
+  for (uint8_t i = 0; i < _count; i++) {
+    Dallas *dallas = _buses[i];
+    if (!dallas->getCheckForConversion() || dallas->isParasitePowerMode()) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool DallasBusGroup::isConversionComplete(void) {
+  for (uint8_t i = 0; i < _count; i++) {
+    if (!_buses[i]->isConversionComplete()) {
+      return false;
+    }
+  }
+  return true;
+}
+
+uint16_t DallasBusGroup::readAllResults(int16_t *raw, uint8_t *status,
+                                        uint16_t n) {
+  uint16_t ok = 0;
+  uint16_t offset = 0;
+  for (uint8_t i = 0; i < _count && offset < n; i++) {
+    uint16_t left = n - offset;
+    uint8_t count = (left > 255) ? 255 : left;
+    ok += _buses[i]->readAllResults(&raw[offset],
+                                    (status != NULL) ? &status[offset] : NULL,
+                                    count);
+    offset += MIN(count, _buses[i]->getDeviceCount());
+  }
+  return ok;
+}
+
+/*
+ * checks the conversions of all the buses and reads them when complete,
+ * otherwise re-arms the timer
+ */
+void DallasBusGroup::timerCb(void *arg) {
+  DallasBusGroup *group = (DallasBusGroup *) arg;
+  uint64_t now = (uint64_t)(mgos_uptime() * 1000 * 1000);
+  if (group->canCheckForConversion() && now < group->_deadline &&
+      !group->isConversionComplete()) {
+    group->_timer = mgos_set_timer(CONVERSION_POLL_MS, 0, timerCb, group);
+    if (group->isReadPending()) {
+      return;
+    }
+  }
+
+  // the callback may start a new read
+  group->_timer = MGOS_INVALID_TIMER_ID;
+  group->readAllResults(group->_raw, group->_status, group->_n);
+  if (group->_cb != NULL) {
+    group->_cb(group, group->_cbArg);
+  }
+}
@@ -0,0 +1,261 @@
+#include "DallasBusWorker.h"
+
+#if DALLAS_BUS_WORKER
+#include <mgos.h>
+#include <string.h>
+
+// Interval between two checks of a running conversion
+#define CONVERSION_POLL_MS 10
+
+// Internal request sent by the destructor, the worker task exits on it
+#define DALLAS_REQUEST_STOP 0xFF
+
+DallasBusWorker::DallasBusWorker(Dallas *dallas)
+    : _dallas(dallas),
+      _queue(NULL),
+      _task(NULL),
+      _converting(false),
+      _conversionStart(0),
+      _conversionTicks(0),
+      _waitingCount(0) {
+}
+
+/*
+ * the stop request is queued behind the pending ones, the task serves them
+ * and acknowledges it as its last access to the worker and the queue
+ */
+DallasBusWorker::~DallasBusWorker() {
+  if (_task != NULL) {
+    Future stopped;
+    initFuture(&stopped);
+    Request request;
+    memset(&request, 0, sizeof(request));
+    request.type = DALLAS_REQUEST_STOP;
+    request.cb = futureCb;
+    request.arg = &stopped;
+    xQueueSend(_queue, &request, portMAX_DELAY);
+    waitFuture(&stopped);
+  }
+  if (_queue != NULL) {
+    vQueueDelete(_queue);
+  }
+}
+
+/*
+ * stackSize is the stack depth as taken by xTaskCreate()
+ */
+bool DallasBusWorker::begin(uint32_t stackSize, UBaseType_t priority) {
+  if (_task != NULL) {
+    return true;
+  }
+  _queue = xQueueCreate(DALLAS_WORKER_QUEUE, sizeof(Request));
+  if (_queue == NULL) {
+    return false;
+  }
+  if (xTaskCreate(taskFn, "dallas", stackSize, this, priority, &_task) !=
+      pdPASS) {
+    vQueueDelete(_queue);
+    _queue = NULL;
+    _task = NULL;
+    return false;
+  }
+  return true;
+}
+
+bool DallasBusWorker::submit(const Request *request) {
+  return (_queue != NULL) && (xQueueSend(_queue, request, 0) == pdTRUE);
+}
+
+bool DallasBusWorker::convert(RequestCallback cb, void *arg) {
+  Request request;
+  memset(&request, 0, sizeof(request));
+  request.type = DALLAS_REQUEST_CONVERT;
+  request.cb = cb;
+  request.arg = arg;
+  return submit(&request);
+}
+
+bool DallasBusWorker::read(const uint8_t *deviceAddress, RequestCallback cb,
+                           void *arg) {
+  Request request;
+  memset(&request, 0, sizeof(request));
+  request.type = DALLAS_REQUEST_READ;
+  memcpy(request.address, deviceAddress, sizeof(request.address));
+  request.cb = cb;
+  request.arg = arg;
+  return submit(&request);
+}
+
+bool DallasBusWorker::readAll(int16_t *raw, uint8_t *status, uint8_t n,
+                              RequestCallback cb, void *arg) {
+  Request request;
+  memset(&request, 0, sizeof(request));
+  request.type = DALLAS_REQUEST_READ_ALL;
+  request.raw = raw;
+  request.status = status;
+  request.n = n;
+  request.cb = cb;
+  request.arg = arg;
+  return submit(&request);
+}
+
+bool DallasBusWorker::rescan(RequestCallback cb, void *arg) {
+  Request request;
+  memset(&request, 0, sizeof(request));
+  request.type = DALLAS_REQUEST_RESCAN;
+  request.cb = cb;
+  request.arg = arg;
+  return submit(&request);
+}
+
+bool DallasBusWorker::setResolution(uint8_t resolution, RequestCallback cb,
+                                    void *arg) {
+  Request request;
+  memset(&request, 0, sizeof(request));
+  request.type = DALLAS_REQUEST_SET_RESOLUTION;
+  request.resolution = resolution;
+  request.cb = cb;
+  request.arg = arg;
+  return submit(&request);
+}
+
+void DallasBusWorker::initFuture(Future *future) {
+  future->task = xTaskGetCurrentTaskHandle();
+  future->result = 0;
+}
+
+void DallasBusWorker::futureCb(DallasBusWorker *worker, uint8_t type,
+                               int32_t result, void *arg) {
+  (void) worker;
+  (void) type;
+  Future *future = (Future *) arg;
+  future->result = result;
+  xTaskNotifyGive(future->task);
+}
+
+int32_t DallasBusWorker::waitFuture(Future *future) {
+  ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+  return future->result;
+}
+
+void DallasBusWorker::taskFn(void *arg) {
+  ((DallasBusWorker *) arg)->run();
+  vTaskDelete(NULL);
+}
+
+/*
+ * while a conversion runs the queue is only watched: conversion requests
+ * join it, any other request needs the bus or the results and waits for its
+ * end. Returns on the stop request.
+ */
+void DallasBusWorker::run(void) {
+  Request request;
+  for (;;) {
+    if (!_converting) {
+      if (xQueueReceive(_queue, &request, portMAX_DELAY) != pdTRUE) {
+        continue;
+      }
+      if (request.type == DALLAS_REQUEST_STOP) {
+        // the destructor returns on this callback, the worker is gone after it
+        request.cb(this, request.type, 1, request.arg);
+        return;
+      }
+      execute(&request);
+      continue;
+    }
+
+    if (waitConversion(false)) {
+      finishConversion();
+      continue;
+    }
+    if (xQueuePeek(_queue, &request, nextCheck()) != pdTRUE) {
+      continue;
+    }
+    if (request.type == DALLAS_REQUEST_CONVERT &&
+        _waitingCount < DALLAS_WORKER_QUEUE) {
+      xQueueReceive(_queue, &request, 0);
+      _waiting[_waitingCount++] = request;
+      continue;
+    }
+    waitConversion(true);
+    finishConversion();
+  }
+}
+
+void DallasBusWorker::execute(const Request *request) {
+  int32_t result = 1;
+  switch (request->type) {
+    case DALLAS_REQUEST_CONVERT:
+      startConversion(request);
+      return;
+    case DALLAS_REQUEST_READ:
+      result = _dallas->getTemp(request->address);
+      break;
+    case DALLAS_REQUEST_READ_ALL:
+      result = _dallas->readAllResults(request->raw, request->status,
+                                       request->n);
+      break;
+    case DALLAS_REQUEST_RESCAN:
+      result = _dallas->rescan(NULL, NULL);
+      break;
+    case DALLAS_REQUEST_SET_RESOLUTION:
+      _dallas->setResolution(request->resolution);
+      break;
+  }
+  if (request->cb != NULL) {
+    request->cb(this, request->type, result, request->arg);
+  }
+}
+
+void DallasBusWorker::startConversion(const Request *request) {
+  int16_t millis = _dallas->millisToWaitForConversion(_dallas->getResolution());
+  _dallas->startConversion();
+  _converting = true;
+  _conversionStart = xTaskGetTickCount();
+  _conversionTicks = pdMS_TO_TICKS(millis) + 1;  // rounded up
+  _waiting[0] = *request;
+  _waitingCount = 1;
+}
+
+/*
+ * the end is polled on the bus unless parasite powered devices need the
+ * strong pullup, else the datasheet time is waited
+ */
+bool DallasBusWorker::canCheckConversion(void) {
+  return _dallas->getCheckForConversion() && !_dallas->isParasitePowerMode();
+}
+
+TickType_t DallasBusWorker::nextCheck(void) {
+  TickType_t elapsed = xTaskGetTickCount() - _conversionStart;
+  TickType_t wait = (elapsed < _conversionTicks) ? _conversionTicks - elapsed
+                                                 : 0;
+  if (canCheckConversion()) {
+    wait = MIN(wait, pdMS_TO_TICKS(CONVERSION_POLL_MS));
+  }
+  return MAX(wait, 1);
+}
+
+bool DallasBusWorker::waitConversion(bool block) {
+  for (;;) {
+    if (xTaskGetTickCount() - _conversionStart >= _conversionTicks ||
+        (canCheckConversion() && _dallas->isConversionComplete())) {
+      return true;
+    }
+    if (!block) {
+      return false;
+    }
+    vTaskDelay(nextCheck());
+  }
+}
+
+void DallasBusWorker::finishConversion(void) {
+  uint8_t count = _waitingCount;
+  _converting = false;
+  _waitingCount = 0;
+  for (uint8_t i = 0; i < count; i++) {
+    if (_waiting[i].cb != NULL) {
+      _waiting[i].cb(this, DALLAS_REQUEST_CONVERT, 1, _waiting[i].arg);
+    }
+  }
+}
+#endif
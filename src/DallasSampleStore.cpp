@@ -0,0 +1,153 @@
+#include <string.h>
+#include "DallasSampleStore.h"
+
+DallasSampleStore::DallasSampleStore() {
+  memset(_windows, 0, sizeof(_windows));
+  clear(NULL);
+}
+
+DallasSampleStore::~DallasSampleStore() {
+}
+
+bool DallasSampleStore::setWindow(uint8_t index, uint32_t millis) {
+  if (index >= DALLAS_SAMPLE_WINDOWS) {
+    return false;
+  }
+  _windows[index] = millis;
+  for (uint8_t i = 0; i < DALLAS_SAMPLE_DEVICES; i++) {
+    _series[i].current[index].count = 0;
+    _series[i].last[index].count = 0;
+  }
+  return true;
+}
+
+DallasSampleStore::Series *DallasSampleStore::find(
+    const uint8_t *deviceAddress, bool create) {
+  Series *free = NULL;
+  for (uint8_t i = 0; i < DALLAS_SAMPLE_DEVICES; i++) {
+    Series *s = &_series[i];
+    if (!s->used) {
+      if (free == NULL) {
+        free = s;
+      }
+    } else if (memcmp(s->address, deviceAddress, sizeof(s->address)) == 0) {
+      return s;
+    }
+  }
+  if (!create || free == NULL) {
+    return NULL;
+  }
+  memset(free, 0, sizeof(*free));
+  memcpy(free->address, deviceAddress, sizeof(free->address));
+  free->used = true;
+  return free;
+}
+
+/*
+ * a sample past the window being filled completes it; samples older than
+ * its start (out of order) are counted in it, so the completed window never
+ * moves back in time. Times compare by their difference to survive the wrap
+ * of the millisecond uptime.
+ */
+bool DallasSampleStore::add(const uint8_t *deviceAddress, uint32_t time,
+                            int16_t raw) {
+  Series *s = find(deviceAddress, true);
+  if (s == NULL) {
+    return false;
+  }
+
+  s->times[s->head] = time;
+  s->raws[s->head] = raw;
+  s->head = (s->head + 1) % DALLAS_SAMPLE_DEPTH;
+  if (s->count < DALLAS_SAMPLE_DEPTH) {
+    s->count++;
+  }
+
+  for (uint8_t i = 0; i < DALLAS_SAMPLE_WINDOWS; i++) {
+    uint32_t window = _windows[i];
+    if (window == 0) {
+      continue;
+    }
+    Accumulator *acc = &s->current[i];
+    int32_t age = (int32_t)(time - acc->start);
+    if (acc->count > 0 && age >= 0 && (uint32_t) age >= window) {
+      s->last[i] = *acc;
+      acc->count = 0;
+    }
+    if (acc->count == 0) {
+      acc->start = time - time % window;
+      acc->sum = 0;
+      acc->min = raw;
+      acc->max = raw;
+    }
+    if (acc->count == UINT16_MAX) {
+      continue;  // the sum is bounded by the count
+    }
+    acc->sum += raw;
+    acc->count++;
+    if (raw < acc->min) {
+      acc->min = raw;
+    }
+    if (raw > acc->max) {
+      acc->max = raw;
+    }
+  }
+  return true;
+}
+
+uint8_t DallasSampleStore::getSamples(const uint8_t *deviceAddress,
+                                      Sample *samples, uint8_t n) {
+  Series *s = find(deviceAddress, false);
+  if (s == NULL) {
+    return 0;
+  }
+  uint8_t count = (n < s->count) ? n : s->count;
+  // the oldest of the last count samples
+  uint8_t index = (s->head + DALLAS_SAMPLE_DEPTH - count) % DALLAS_SAMPLE_DEPTH;
+  for (uint8_t i = 0; i < count; i++) {
+    samples[i].time = s->times[index];
+    samples[i].raw = s->raws[index];
+    index = (index + 1) % DALLAS_SAMPLE_DEPTH;
+  }
+  return count;
+}
+
+bool DallasSampleStore::getLast(const uint8_t *deviceAddress, Sample *sample) {
+  return getSamples(deviceAddress, sample, 1) == 1;
+}
+
+void DallasSampleStore::toRollup(const Accumulator *acc, Rollup *rollup) {
+  int32_t half = acc->count / 2;
+  rollup->start = acc->start;
+  rollup->min = acc->min;
+  rollup->max = acc->max;
+  // rounded to nearest, halves away from zero
+  rollup->mean = (acc->sum >= 0) ? (acc->sum + half) / acc->count
+                                 : -((-acc->sum + half) / acc->count);
+  rollup->count = acc->count;
+}
+
+bool DallasSampleStore::getRollup(const uint8_t *deviceAddress, uint8_t index,
+                                  bool current, Rollup *rollup) {
+  Series *s = find(deviceAddress, false);
+  if (s == NULL || index >= DALLAS_SAMPLE_WINDOWS) {
+    return false;
+  }
+  const Accumulator *acc = current ? &s->current[index] : &s->last[index];
+  if (acc->count == 0) {
+    return false;
+  }
+  toRollup(acc, rollup);
+  return true;
+}
+
+void DallasSampleStore::clear(const uint8_t *deviceAddress) {
+  if (deviceAddress == NULL) {
+    memset(_series, 0, sizeof(_series));
+    return;
+  }
+  Series *s = find(deviceAddress, false);
+  if (s != NULL) {
+    s->used = false;
+  }
+}
@@ -0,0 +1,524 @@
+#ifdef __linux__
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "LinuxW1Onewire.h"
+
+// Model IDs
+#define DS18S20MODEL 0x10
+
+// Function commands
+#define STARTCONVO 0x44
+#define COPYSCRATCH 0x48
+#define READSCRATCH 0xBE
+#define WRITESCRATCH 0x4E
+#define RECALLSCRATCH 0xB8
+#define READPOWERSUPPLY 0xB4
+
+#define W1_PATH_MAX 256
+
+// A line of w1_master_slaves, e.g. "28-0000056a1b2c"
+#define W1_NAME_LEN 15
+
+// Content of w1_slave: two lines of 9 bytes and the CRC check/temperature
+#define W1_SLAVE_MAX 128
+
+LinuxW1Onewire::LinuxW1Onewire(const char *master)
+    : _master(strdup(master)),
+      _target(TARGET_NONE),
+      _pendingLen(0),
+      _command(0),
+      _answerLen(0),
+      _position(0),
+      _roms(NULL),
+      _romCount(0),
+      _readings(NULL),
+      _readingCount(0) {
+  reset_search();
+}
+
+LinuxW1Onewire::~LinuxW1Onewire() {
+  free(_master);
+  delete[] _roms;
+  delete[] _readings;
+}
+
+void LinuxW1Onewire::path(char *buf, size_t size, const uint8_t *rom,
+                          const char *file) {
+  if (rom == NULL) {
+    snprintf(buf, size, "%s/%s", _master, file);
+    return;
+  }
+  // the serial number is shown most significant byte first
+  snprintf(buf, size, "%s/%02x-%02x%02x%02x%02x%02x%02x/%s", _master, rom[0],
+           rom[6], rom[5], rom[4], rom[3], rom[2], rom[1], file);
+}
+
+bool LinuxW1Onewire::readAttribute(const uint8_t *rom, const char *file,
+                                   char *buf, size_t size) {
+  char name[W1_PATH_MAX];
+  path(name, sizeof(name), rom, file);
+  int fd = open(name, O_RDONLY);
+  if (fd < 0) {
+    return false;
+  }
+  ssize_t len = ::read(fd, buf, size - 1);
+  close(fd);
+  if (len < 0) {
+    return false;
+  }
+  buf[len] = '\0';
+  return true;
+}
+
+bool LinuxW1Onewire::writeAttribute(const uint8_t *rom, const char *file,
+                                    const char *value) {
+  char name[W1_PATH_MAX];
+  path(name, sizeof(name), rom, file);
+  int fd = open(name, O_WRONLY | O_TRUNC);
+  if (fd < 0) {
+    return false;
+  }
+  size_t len = strlen(value);
+  bool ok = (::write(fd, value, len) == (ssize_t) len);
+  close(fd);
+  return ok;
+}
+
+/*
+ * the kernel removes the directory of a device that left the bus
+ */
+bool LinuxW1Onewire::devicePresent(const uint8_t *rom) {
+  char name[W1_PATH_MAX];
+  path(name, sizeof(name), rom, "");
+  return (access(name, F_OK) == 0);
+}
+
+LinuxW1Onewire::Reading *LinuxW1Onewire::reading(const uint8_t *rom,
+                                                 bool create) {
+  for (uint16_t i = 0; i < _readingCount; i++) {
+    if (memcmp(_readings[i].rom, rom, 8) == 0) {
+      return &_readings[i];
+    }
+  }
+  if (!create) {
+    return NULL;
+  }
+  Reading *readings = new Reading[_readingCount + 1];
+  if (_readingCount > 0) {
+    memcpy(readings, _readings, _readingCount * sizeof(Reading));
+  }
+  delete[] _readings;
+  _readings = readings;
+  Reading *r = &_readings[_readingCount++];
+  memcpy(r->rom, rom, 8);
+  r->valid = false;
+  r->converted = false;
+  return r;
+}
+
+void LinuxW1Onewire::bulkConvert(void) {
+  writeAttribute(NULL, "therm_bulk_read", "trigger\n");
+  loadRoms();
+  for (uint16_t i = 0; i < _romCount; i++) {
+    reading(&_roms[i * 8], true)->converted = true;
+  }
+}
+
+/*
+ * reading w1_slave outside a bulk conversion makes the kernel convert the
+ * device first, up to 750ms each
+ */
+bool LinuxW1Onewire::readScratchPad(const uint8_t *rom, uint8_t *scratchPad) {
+  Reading *r = reading(rom, true);
+  if (r->converted) {
+    r->converted = false;
+    if (!parseScratchPad(rom, r->scratchPad)) {
+      return false;
+    }
+    r->valid = true;
+    memcpy(scratchPad, r->scratchPad, 9);
+    return true;
+  }
+  if (!devicePresent(rom)) {
+    return false;
+  }
+  attributeScratchPad(rom, r, scratchPad);
+  return true;
+}
+
+/*
+ * alarms shows "TL TH", resolution the bits; without a reading the
+ * temperature is the power-on value
+ */
+void LinuxW1Onewire::attributeScratchPad(const uint8_t *rom,
+                                         const Reading *last,
+                                         uint8_t *scratchPad) {
+  static const uint8_t powerOn[9] = {0x50, 0x05, 0x4B, 0x46, 0x7F,
+                                     0xFF, 0x0C, 0x10, 0x00};
+  static const uint8_t powerOnDS18S20[9] = {0xAA, 0x00, 0x4B, 0x46, 0xFF,
+                                            0xFF, 0x0C, 0x10, 0x00};
+  if (last->valid) {
+    memcpy(scratchPad, last->scratchPad, 9);
+  } else {
+    memcpy(scratchPad, (rom[0] == DS18S20MODEL) ? powerOnDS18S20 : powerOn,
+           9);
+  }
+
+  char value[32];
+  int low, high;
+  if (readAttribute(rom, "alarms", value, sizeof(value)) &&
+      sscanf(value, "%d %d", &low, &high) == 2) {
+    scratchPad[2] = (uint8_t) high;
+    scratchPad[3] = (uint8_t) low;
+  }
+  int bits;
+  if (rom[0] != DS18S20MODEL &&
+      readAttribute(rom, "resolution", value, sizeof(value)) &&
+      sscanf(value, "%d", &bits) == 1 && bits >= 9 && bits <= 12) {
+    scratchPad[4] = ((bits - 9) << 5) | 0x1F;
+  }
+  scratchPad[8] = crc8(scratchPad, 8);
+}
+
+/*
+ * the first line of w1_slave shows the scratchpad in hex, e.g.
+ * "72 01 4b 46 7f ff 0e 10 57 : crc=57 YES"
+ */
+bool LinuxW1Onewire::parseScratchPad(const uint8_t *rom, uint8_t *scratchPad) {
+  char text[W1_SLAVE_MAX];
+  if (!readAttribute(rom, "w1_slave", text, sizeof(text))) {
+    return false;
+  }
+  char *p = text;
+  for (int i = 0; i < 9; i++) {
+    char *end;
+    unsigned long v = strtoul(p, &end, 16);
+    if (end == p || v > 0xFF) {
+      return false;
+    }
+    scratchPad[i] = v;
+    p = end;
+  }
+  return true;
+}
+
+/*
+ * data: TH, TL and the configuration register (not for DS18S20)
+ */
+void LinuxW1Onewire::writeScratchPad(const uint8_t *rom, const uint8_t *data,
+                                     uint8_t len) {
+  char value[16];
+  if (len >= 2) {
+    snprintf(value, sizeof(value), "%d %d\n", (int8_t) data[1],
+             (int8_t) data[0]);
+    writeAttribute(rom, "alarms", value);
+  }
+  if (len >= 3 && rom[0] != DS18S20MODEL) {
+    snprintf(value, sizeof(value), "%d\n", ((data[2] >> 5) & 0x03) + 9);
+    writeAttribute(rom, "resolution", value);
+  }
+}
+
+uint8_t LinuxW1Onewire::readPowerSupply(const uint8_t *rom) {
+  char value[8];
+  if (!readAttribute(rom, "ext_power", value, sizeof(value))) {
+    return 1;  // not provided by the kernel: idle bus
+  }
+  return (atoi(value) == 0) ? 0 : 1;
+}
+
+void LinuxW1Onewire::runCommand(const uint8_t *rom) {
+  switch (_command) {
+    case READSCRATCH:
+      // several devices answering at once cannot be read through sysfs
+      if (_target == TARGET_DEVICE && readScratchPad(rom, _answer)) {
+        _answerLen = 9;
+      }
+      break;
+    case WRITESCRATCH:
+      writeScratchPad(rom, &_pending[1], _pendingLen - 1);
+      break;
+    case COPYSCRATCH:
+      writeAttribute(rom, "eeprom_cmd", "save\n");
+      break;
+    case RECALLSCRATCH:
+      writeAttribute(rom, "eeprom_cmd", "restore\n");
+      break;
+    case READPOWERSUPPLY:
+      // a parasite powered device pulls the read slots low
+      if (_answerLen == 0) {
+        _answer[0] = 0xFF;
+        _answerLen = 1;
+      }
+      if (readPowerSupply(rom) == 0) {
+        _answer[0] = 0x00;
+      }
+      break;
+  }
+}
+
+/*
+ * w1_therm has no single device conversion, a convert T always runs as bulk
+ * conversion
+ */
+void LinuxW1Onewire::flush(void) {
+  if (_pendingLen == 0) {
+    return;
+  }
+  _command = _pending[0];
+  _answerLen = 0;
+  _position = 0;
+  if (_target == TARGET_NONE) {
+    // no rom command: the devices ignore the bytes
+  } else if (_command == STARTCONVO) {
+    bulkConvert();
+  } else if (_target == TARGET_DEVICE) {
+    runCommand(_rom);
+  } else {
+    loadRoms();
+    for (uint16_t i = 0; i < _romCount; i++) {
+      runCommand(&_roms[i * 8]);
+    }
+  }
+  _pendingLen = 0;
+}
+
+void LinuxW1Onewire::endCommand(void) {
+  flush();
+  _target = TARGET_NONE;
+  _command = 0;
+  _answerLen = 0;
+}
+
+/*
+ * the devices are sorted by family, like the order of a search on the bus,
+ * so a targeted search returns the devices of a family one after the other
+ */
+void LinuxW1Onewire::loadRoms(void) {
+  char name[W1_PATH_MAX];
+  path(name, sizeof(name), NULL, "w1_master_slaves");
+  FILE *f = fopen(name, "r");
+  delete[] _roms;
+  _roms = NULL;
+  _romCount = 0;
+  if (f == NULL) {
+    return;
+  }
+
+  char line[64];
+  uint16_t lines = 0;
+  while (fgets(line, sizeof(line), f) != NULL) {
+    lines++;
+  }
+  _roms = new uint8_t[lines * 8];
+  rewind(f);
+
+  while (_romCount < lines && fgets(line, sizeof(line), f) != NULL) {
+    unsigned int family;
+    unsigned long long serial;
+    char *end;
+    if (strlen(line) < W1_NAME_LEN || line[2] != '-') {
+      continue;  // e.g. "not found."
+    }
+    family = strtoul(line, &end, 16);
+    serial = strtoull(line + 3, &end, 16);
+    if (end != line + W1_NAME_LEN) {
+      continue;
+    }
+    uint8_t rom[8];
+    rom[0] = family;
+    for (int i = 1; i < 7; i++) {
+      rom[i] = (serial >> (8 * (i - 1))) & 0xFF;
+    }
+    rom[7] = crc8(rom, 7);
+
+    // insert after the devices of the same or a lower family
+    uint16_t pos = _romCount;
+    while (pos > 0 && _roms[(pos - 1) * 8] > family) {
+      memcpy(&_roms[pos * 8], &_roms[(pos - 1) * 8], 8);
+      pos--;
+    }
+    memcpy(&_roms[pos * 8], rom, 8);
+    _romCount++;
+  }
+  fclose(f);
+}
+
+/*
+ * the kernel resets the bus for every attribute access, so a reset only ends
+ * the running command. With a device selected next, the presence is the
+ * device directory, see transact()
+ */
+uint8_t LinuxW1Onewire::reset(void) {
+  endCommand();
+
+  char count[16];
+  if (!readAttribute(NULL, "w1_master_slave_count", count, sizeof(count))) {
+    return 0;
+  }
+  return (atoi(count) > 0) ? 1 : 0;
+}
+
+void LinuxW1Onewire::select(const uint8_t rom[8]) {
+  endCommand();
+  memcpy(_rom, rom, 8);
+  _target = TARGET_DEVICE;
+}
+
+void LinuxW1Onewire::skip(void) {
+  endCommand();
+  _target = TARGET_BROADCAST;
+}
+
+/*
+ * bytes beyond the longest function command (write scratchpad) are dropped
+ */
+void LinuxW1Onewire::write(uint8_t v, uint8_t power) {
+  (void) power;  // the kernel applies the strong pullup
+  if (_pendingLen < sizeof(_pending)) {
+    _pending[_pendingLen++] = v;
+  }
+}
+
+void LinuxW1Onewire::write_bytes(const uint8_t *buf, uint16_t count,
+                                 bool power) {
+  for (uint16_t i = 0; i < count; i++) {
+    write(buf[i], power);
+  }
+}
+
+uint8_t LinuxW1Onewire::read(void) {
+  uint8_t v;
+  read_bytes(&v, 1);
+  return v;
+}
+
+/*
+ * returns the bytes answered by the function command, then 0xFF (idle bus)
+ */
+void LinuxW1Onewire::read_bytes(uint8_t *buf, uint16_t count) {
+  flush();
+  for (uint16_t i = 0; i < count; i++) {
+    buf[i] = (_position < _answerLen) ? _answer[_position++] : 0xFF;
+  }
+}
+
+/*
+ * single bits cannot be written through sysfs
+ */
+void LinuxW1Onewire::write_bit(uint8_t v) {
+  (void) v;
+  flush();
+}
+
+/*
+ * after convert T therm_bulk_read reads -1 while the conversion runs, after
+ * read power supply the power mode is returned, otherwise the idle bus
+ */
+uint8_t LinuxW1Onewire::read_bit(void) {
+  flush();
+  switch (_command) {
+    case STARTCONVO: {
+      char state[8];
+      if (readAttribute(NULL, "therm_bulk_read", state, sizeof(state)) &&
+          atoi(state) == -1) {
+        return 0;
+      }
+      return 1;
+    }
+    case READPOWERSUPPLY:
+      return (_answerLen > 0) ? (_answer[0] & 0x01) : 1;
+  }
+  return 1;
+}
+
+void LinuxW1Onewire::depower(void) {
+  flush();
+}
+
+void LinuxW1Onewire::reset_search() {
+  _searchIndex = 0;
+  _targetFamily = -1;
+}
+
+void LinuxW1Onewire::target_search(uint8_t family_code) {
+  _searchIndex = 0;
+  _targetFamily = family_code;
+}
+
+/*
+ * returns the devices listed by the master, which runs the search on the bus
+ */
+uint8_t LinuxW1Onewire::search(uint8_t *newAddr, bool search_mode) {
+  if (!search_mode) {
+    reset_search();
+    return 0;  // no alarm search through sysfs
+  }
+  if (_searchIndex == 0) {
+    loadRoms();
+    // without a device of the family the search returns the first device
+    for (uint16_t i = 0; _targetFamily >= 0 && i < _romCount; i++) {
+      if (_roms[i * 8] == _targetFamily) {
+        _searchIndex = i;
+        break;
+      }
+    }
+    _targetFamily = -1;
+  }
+  if (_searchIndex >= _romCount) {
+    reset_search();
+    return 0;
+  }
+  memcpy(newAddr, &_roms[_searchIndex * 8], 8);
+  _searchIndex++;
+  return 1;
+}
+
+/*
+ * a reset followed by a match rom succeeds if the device is listed by the
+ * kernel, the rest of the ops are run by the primitives
+ */
+bool LinuxW1Onewire::transact(const OwOp *ops, uint8_t count) {
+  for (uint8_t i = 0; i < count; i++) {
+    const OwOp *op = &ops[i];
+    if (op->type == OW_OP_RESET && i + 1 < count &&
+        ops[i + 1].type == OW_OP_SELECT) {
+      endCommand();
+      uint8_t presence = devicePresent(ops[i + 1].data) ? 1 : 0;
+      if (op->buf != NULL) {
+        op->buf[0] = presence;
+      }
+      if (presence == 0) {
+        return false;
+      }
+      select(ops[i + 1].data);
+      i++;
+      continue;
+    }
+    if (!OnewireInterface::transact(op, 1)) {
+      return false;
+    }
+  }
+  flush();
+  return true;
+}
+
+uint8_t LinuxW1Onewire::crc8(const uint8_t *addr, uint8_t len) {
+  uint8_t crc = 0;
+  while (len-- > 0) {
+    uint8_t inbyte = *addr++;
+    for (int i = 8; i > 0; i--) {
+      uint8_t mix = (crc ^ inbyte) & 0x01;
+      crc >>= 1;
+      if (mix) {
+        crc ^= 0x8C;
+      }
+      inbyte >>= 1;
+    }
+  }
+  return crc;
+}
+#endif
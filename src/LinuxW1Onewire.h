@@ -0,0 +1,178 @@
+#pragma once
+#ifdef __linux__
+#include <stddef.h>
+#include <stdint.h>
+#include "OnewireInterface.h"
+
+/*
+ * 1-Wire bus owned by the Linux kernel w1 subsystem, driven through the sysfs
+ * attributes of the w1_therm driver. The function commands of Dallas are
+ * mapped to them:
+ * - search: <master>/w1_master_slaves
+ * - presence of a device: the device directory <master>/<family>-<serial>
+ * - convert T (skip or match rom): writes "trigger" to
+ *   <master>/therm_bulk_read, which converts on every device; a read slot
+ *   polls it
+ * - read scratchpad: the first read of a device after convert T returns the
+ *   9 bytes shown by <device>/w1_slave. Other reads return the temperature
+ *   bytes of the last w1_slave read (the 85 C power-on value before any) with
+ *   TH, TL and the configuration of the alarms and resolution attributes
+ * - write scratchpad: TH and TL to <device>/alarms, the resolution of the
+ *   configuration byte to <device>/resolution
+ * - copy scratchpad / recall E2: "save" / "restore" to <device>/eeprom_cmd
+ * - read power supply: <device>/ext_power, after skip rom the devices are
+ *   read one by one and a read slot returns 0 if any is parasite powered. If
+ *   the kernel does not provide ext_power, a read slot returns 1 (external
+ *   power), like an idle bus.
+ * After skip rom the scratchpad and EEPROM commands are applied to every
+ * device listed by the master.
+ *
+ * Kernel setup: a bus master driver (e.g. w1-gpio, "dtoverlay=w1-gpio" on a
+ * Raspberry Pi, or ds2482) and the w1_therm module of Linux 5.10 or later,
+ * which provides therm_bulk_read, alarms, resolution, eeprom_cmd and
+ * ext_power. Parasite powered devices need w1_therm loaded with
+ * strong_pullup=1 (the default) and a master able to drive it. Writing the
+ * attributes requires root or a matching udev rule.
+ *
+ * w1_slave returns the result of the last bulk conversion once; other reads
+ * of it make the kernel convert that device first, which takes up to the
+ * conversion time, so it is not read outside a bulk conversion (e.g. by
+ * Dallas::begin()). Overdrive speed, alarm search and raw bus access are not
+ * available.
+ */
+class LinuxW1Onewire : public OnewireInterface {
+ public:
+  /*
+   * master: sysfs directory of the bus master
+   */
+  LinuxW1Onewire(const char *master = "/sys/bus/w1/devices/w1_bus_master1");
+  virtual ~LinuxW1Onewire();
+
+  /*
+   * OnewireInterface
+   */
+  virtual uint8_t reset(void);
+  virtual void select(const uint8_t rom[8]);
+  virtual void skip(void);
+  virtual void write(uint8_t v, uint8_t power = 0);
+  virtual void write_bytes(const uint8_t *buf, uint16_t count,
+                           bool power = 0);
+  virtual uint8_t read(void);
+  virtual void read_bytes(uint8_t *buf, uint16_t count);
+  virtual void write_bit(uint8_t v);
+  virtual uint8_t read_bit(void);
+  virtual void depower(void);
+  virtual void reset_search();
+  virtual void target_search(uint8_t family_code);
+  virtual uint8_t search(uint8_t *newAddr, bool search_mode = true);
+  virtual bool transact(const OwOp *ops, uint8_t count);
+
+ protected:
+  /*
+   * Last scratchpad read from w1_slave of a device, converted is set from a
+   * bulk conversion until w1_slave is read
+   */
+  typedef struct {
+    uint8_t rom[8];
+    uint8_t scratchPad[9];
+    bool valid;
+    bool converted;
+  } Reading;
+
+  enum Target {
+    TARGET_NONE,       // no rom command since the last reset
+    TARGET_DEVICE,     // match rom
+    TARGET_BROADCAST,  // skip rom
+  };
+
+  char *_master;
+  Target _target;
+  uint8_t _rom[8];
+
+  /*
+   * Function command and data bytes written since the rom command, run when
+   * the bus is read or reset or at the end of a transaction
+   */
+  uint8_t _pending[16];
+  uint8_t _pendingLen;
+
+  /*
+   * Last function command run and the bytes it answers
+   */
+  uint8_t _command;
+  uint8_t _answer[9];
+  uint8_t _answerLen;
+  uint8_t _position;
+
+  /*
+   * Search state: the roms listed by the master and the next one returned
+   */
+  uint8_t *_roms;
+  uint16_t _romCount;
+  uint16_t _searchIndex;
+  int _targetFamily;
+
+  Reading *_readings;
+  uint16_t _readingCount;
+
+  /*
+   * Builds <master>/<rom name>/<file> or <master>/<file> if rom is NULL
+   */
+  void path(char *buf, size_t size, const uint8_t *rom, const char *file);
+
+  /*
+   * Reads up to size - 1 characters of an attribute, returns false if it
+   * cannot be read
+   */
+  bool readAttribute(const uint8_t *rom, const char *file, char *buf,
+                     size_t size);
+  bool writeAttribute(const uint8_t *rom, const char *file, const char *value);
+
+  bool devicePresent(const uint8_t *rom);
+
+  /*
+   * Parses the scratchpad bytes shown by w1_slave after a bulk conversion,
+   * else builds them from the last reading and the attributes
+   */
+  bool readScratchPad(const uint8_t *rom, uint8_t *scratchPad);
+  bool parseScratchPad(const uint8_t *rom, uint8_t *scratchPad);
+  void attributeScratchPad(const uint8_t *rom, const Reading *last,
+                           uint8_t *scratchPad);
+
+  /*
+   * Starts a conversion on every device listed by the master
+   */
+  void bulkConvert(void);
+
+  /*
+   * Returns the reading of the device, a new one if create is set
+   */
+  Reading *reading(const uint8_t *rom, bool create);
+  void writeScratchPad(const uint8_t *rom, const uint8_t *data, uint8_t len);
+
+  /*
+   * Returns 0 if the device is parasite powered, else 1
+   */
+  uint8_t readPowerSupply(const uint8_t *rom);
+
+  /*
+   * Runs the pending function command on the selected device, or on every
+   * device after skip rom
+   */
+  void flush(void);
+  void runCommand(const uint8_t *rom);
+
+  /*
+   * Runs the pending command and forgets the rom and function command, as a
+   * reset does
+   */
+  void endCommand(void);
+
+  /*
+   * Reads w1_master_slaves into _roms
+   */
+  void loadRoms(void);
+
+  static uint8_t crc8(const uint8_t *addr, uint8_t len);
+};
+#endif
@@ -6,3 +6,73 @@ OnewireInterface::OnewireInterface() {
 
 OnewireInterface::~OnewireInterface() {
 }
+
+// ROM commands
+#define OVERDRIVESKIP 0x3C
+#define OVERDRIVEMATCH 0x69
+
+bool OnewireInterface::has_overdrive(void) {
+  return false;
+}
+
+bool OnewireInterface::set_overdrive(bool overdrive) {
+  return !overdrive;
+}
+
+void OnewireInterface::overdrive_skip(void) {
+  write(OVERDRIVESKIP);
+  set_overdrive(true);
+}
+
+void OnewireInterface::overdrive_select(const uint8_t rom[8]) {
+  write(OVERDRIVEMATCH);
+  set_overdrive(true);
+  write_bytes(rom, 8);
+}
+
+bool OnewireInterface::transact(const OwOp *ops, uint8_t count) {
+  for (uint8_t i = 0; i < count; i++) {
+    const OwOp *op = &ops[i];
+    switch (op->type) {
+      case OW_OP_RESET: {
+        uint8_t presence = reset();
+        if (op->buf != NULL) {
+          op->buf[0] = presence;
+        }
+        if (presence == 0) {
+          return false;
+        }
+        break;
+      }
+      case OW_OP_SELECT:
+        select(op->data);
+        break;
+      case OW_OP_SKIP:
+        skip();
+        break;
+      case OW_OP_OVERDRIVE_SELECT:
+        overdrive_select(op->data);
+        break;
+      case OW_OP_OVERDRIVE_SKIP:
+        overdrive_skip();
+        break;
+      case OW_OP_WRITE:
+        if (op->len == 1) {
+          write(op->data[0], op->arg);
+        } else {
+          write_bytes(op->data, op->len, op->arg);
+        }
+        break;
+      case OW_OP_READ:
+        read_bytes(op->buf, op->len);
+        break;
+      case OW_OP_READ_BIT:
+        op->buf[0] = read_bit();
+        break;
+      case OW_OP_SPEED:
+        set_overdrive(op->arg);
+        break;
+    }
+  }
+  return true;
+}
@@ -1,4 +1,29 @@
 #pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Steps of a transaction, see OnewireInterface::transact()
+ */
+enum OwOpType {
+  OW_OP_RESET,             // reset, buf (optional) receives the presence
+  OW_OP_SELECT,            // match rom, data: rom
+  OW_OP_SKIP,              // skip rom
+  OW_OP_OVERDRIVE_SELECT,  // overdrive match rom, data: rom
+  OW_OP_OVERDRIVE_SKIP,    // overdrive skip rom
+  OW_OP_WRITE,             // write len bytes of data, arg: power
+  OW_OP_READ,              // read len bytes into buf
+  OW_OP_READ_BIT,          // read one bit into buf[0]
+  OW_OP_SPEED,             // arg: 1 overdrive, 0 standard speed
+};
+
+typedef struct {
+  uint8_t type;  // OwOpType
+  uint8_t arg;
+  uint16_t len;
+  const uint8_t *data;
+  uint8_t *buf;
+} OwOp;
 
 class OnewireInterface {
  public:
@@ -78,4 +103,38 @@ class OnewireInterface {
    * the same devices in the same order.
    */
   virtual uint8_t search(uint8_t *newAddr, bool search_mode = true) = 0;
+
+  /*
+   * Returns true if the backend can run the time slots at overdrive speed.
+   * The default implementation supports only standard speed.
+   */
+  virtual bool has_overdrive(void);
+
+  /*
+   * Switches the time slots of the master to overdrive or standard speed.
+   * A reset at standard speed returns all devices to standard speed.
+   * Returns false if the speed is not supported.
+   */
+  virtual bool set_overdrive(bool overdrive);
+
+  /*
+   * Issues a 1-Wire overdrive skip rom command at standard speed and switches
+   * to overdrive speed, addressing all overdrive capable devices on bus.
+   */
+  virtual void overdrive_skip(void);
+
+  /*
+   * Issues a 1-Wire overdrive match rom command at standard speed and sends
+   * the rom at overdrive speed, you do the reset first.
+   */
+  virtual void overdrive_select(const uint8_t rom[8]);
+
+  /*
+   * Runs count ops in order as one transaction. Backends able to run a whole
+   * command in one burst (e.g. DMA or an I2C bridge) override it, the default
+   * implementation runs the ops with the primitives above.
+   * Returns false if a reset is not answered by a presence pulse, the ops
+   * after that reset are not run.
+   */
+  virtual bool transact(const OwOp *ops, uint8_t count);
 };
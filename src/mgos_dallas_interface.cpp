@@ -1,5 +1,4 @@
 #include "mgos_dallas_interface.h"
-#include <math.h>
 
 #ifndef NULL
 #define NULL 0
@@ -18,6 +17,29 @@ void mgos_dallas_begin(Dallas *dt) {
   }
 }
 
+int mgos_dallas_refresh_device_table(Dallas *dt) {
+  return (NULL == dt) ? 0 : dt->refreshDeviceTable();
+}
+
+int mgos_dallas_rescan(Dallas *dt, mgos_dallas_device_change_cb_t cb,
+                       void *arg) {
+  return (NULL == dt) ? 0 : dt->rescan(cb, arg);
+}
+
+bool mgos_dallas_save_inventory(Dallas *dt, const char *path) {
+  return (NULL == dt) ? false : dt->saveInventory(path);
+}
+
+bool mgos_dallas_load_inventory(Dallas *dt, const char *path, int samples) {
+  return (NULL == dt || samples < 0)
+             ? false
+             : dt->loadInventory(path, (samples > 255) ? 255 : samples);
+}
+
+bool mgos_dallas_begin_with_inventory(Dallas *dt, const char *path) {
+  return (NULL == dt) ? false : dt->begin(path);
+}
+
 int mgos_dallas_get_device_count(Dallas *dt) {
   return (NULL == dt) ? 0 : dt->getDeviceCount();
 }
@@ -56,10 +78,20 @@ void mgos_dallas_write_scratch_pad(Dallas *dt, const uint8_t *addr,
   }
 }
 
+void mgos_dallas_invalidate_scratch_pad_cache(Dallas *dt) {
+  if (NULL != dt) {
+    dt->invalidateScratchPadCache();
+  }
+}
+
 bool mgos_dallas_read_power_supply(Dallas *dt, const uint8_t *addr) {
   return (NULL == dt) ? false : dt->readPowerSupply((uint8_t *) addr);
 }
 
+bool mgos_dallas_is_parasite(Dallas *dt, const uint8_t *addr) {
+  return (NULL == dt || NULL == addr) ? false : dt->isParasite(addr);
+}
+
 int mgos_dallas_get_global_resolution(Dallas *dt) {
   return (NULL == dt) ? 0 : dt->getResolution();
 }
@@ -70,6 +102,11 @@ void mgos_dallas_set_global_resolution(Dallas *dt, int res) {
   }
 }
 
+bool mgos_dallas_set_global_resolution_ex(Dallas *dt, int res,
+                                          bool copy_to_eeprom, bool verify) {
+  return (NULL == dt) ? false : dt->setResolution(res, copy_to_eeprom, verify);
+}
+
 int mgos_dallas_get_resolution(Dallas *dt, const uint8_t *addr) {
   return (NULL == dt) ? 0 : dt->getResolution((uint8_t *) addr);
 }
@@ -81,6 +118,40 @@ bool mgos_dallas_set_resolution(Dallas *dt, const uint8_t *addr, int res,
              : dt->setResolution((uint8_t *) addr, res, skip_global_calc);
 }
 
+bool mgos_dallas_get_alarm_thresholds(Dallas *dt, const uint8_t *addr,
+                                      int8_t *low, int8_t *high) {
+  return (NULL == dt) ? false : dt->getAlarmThresholds(addr, low, high);
+}
+
+void mgos_dallas_set_global_alarm_thresholds(Dallas *dt, int low, int high) {
+  if (NULL != dt) {
+    dt->setAlarmThresholds((int8_t) low, (int8_t) high);
+  }
+}
+
+bool mgos_dallas_set_alarm_thresholds(Dallas *dt, const uint8_t *addr, int low,
+                                      int high) {
+  return (NULL == dt) ? false
+                      : dt->setAlarmThresholds(addr, (int8_t) low,
+                                               (int8_t) high);
+}
+
+void mgos_dallas_reset_alarm_search(Dallas *dt) {
+  if (NULL != dt) {
+    dt->resetAlarmSearch();
+  }
+}
+
+bool mgos_dallas_alarm_search(Dallas *dt, uint8_t *addr) {
+  return (NULL == dt) ? false : dt->alarmSearch(addr);
+}
+
+int mgos_dallas_get_alarm_devices(Dallas *dt, uint8_t *indexes, int n) {
+  return (NULL == dt) ? 0
+                      : dt->getAlarmDevices(indexes,
+                                            (n < 0) ? 0 : (n > 255 ? 255 : n));
+}
+
 void mgos_dallas_set_wait_for_conversion(Dallas *dt, bool f) {
   if (NULL != dt) {
     dt->setWaitForConversion(f);
@@ -101,12 +172,96 @@ bool mgos_dallas_get_check_for_conversion(Dallas *dt) {
   return (NULL == dt) ? false : dt->getCheckForConversion();
 }
 
+void mgos_dallas_set_overdrive(Dallas *dt, bool f) {
+  if (NULL != dt) {
+    dt->setOverdrive(f);
+  }
+}
+
+bool mgos_dallas_get_overdrive(Dallas *dt) {
+  return (NULL == dt) ? false : dt->getOverdrive();
+}
+
+void mgos_dallas_set_short_read(Dallas *dt, bool f) {
+  if (NULL != dt) {
+    dt->setShortRead(f);
+  }
+}
+
+bool mgos_dallas_get_short_read(Dallas *dt) {
+  return (NULL == dt) ? false : dt->getShortRead();
+}
+
+void mgos_dallas_set_quarantine_threshold(Dallas *dt, int n) {
+  if (NULL != dt && n >= 0) {
+    dt->setQuarantineThreshold((n > 255) ? 255 : n);
+  }
+}
+
+int mgos_dallas_get_quarantine_threshold(Dallas *dt) {
+  return (NULL == dt) ? 0 : dt->getQuarantineThreshold();
+}
+
+bool mgos_dallas_get_device_errors(Dallas *dt, int idx, int *crc,
+                                   int *presence, int *consecutive) {
+  const Dallas::DeviceInfo *info =
+      (NULL == dt || idx < 0 || idx > 255) ? NULL : dt->getDeviceInfo(idx);
+  if (NULL == info) {
+    return false;
+  }
+  if (NULL != crc) {
+    *crc = info->crcErrors;
+  }
+  if (NULL != presence) {
+    *presence = info->presenceErrors;
+  }
+  if (NULL != consecutive) {
+    *consecutive = info->consecutiveErrors;
+  }
+  return true;
+}
+
+bool mgos_dallas_is_quarantined(Dallas *dt, int idx) {
+  return (NULL == dt || idx < 0 || idx > 255) ? false : dt->isQuarantined(idx);
+}
+
+void mgos_dallas_reset_device_errors(Dallas *dt) {
+  if (NULL != dt) {
+    dt->resetDeviceErrors();
+  }
+}
+
 void mgos_dallas_request_temperatures(Dallas *dt) {
   if (NULL != dt) {
     dt->requestTemperatures();
   }
 }
 
+bool mgos_dallas_request_temperatures_async(Dallas *dt,
+                                            mgos_dallas_conversion_cb_t cb,
+                                            void *arg) {
+  return (NULL == dt) ? false : dt->requestTemperaturesAsync(cb, arg);
+}
+
+bool mgos_dallas_read_all_staged_async(Dallas *dt, int16_t *raw,
+                                       uint8_t *status, int n,
+                                       mgos_dallas_stage_cb_t cb, void *arg) {
+  return (NULL == dt || n <= 0)
+             ? false
+             : dt->readAllStagedAsync(raw, status, (n > 255) ? 255 : n, cb,
+                                      arg);
+}
+
+bool mgos_dallas_is_conversion_pending(Dallas *dt) {
+  return (NULL == dt) ? false : dt->isConversionPending();
+}
+
+void mgos_dallas_cancel_conversion(Dallas *dt) {
+  if (NULL != dt) {
+    dt->cancelConversion();
+  }
+}
+
 bool mgos_dallas_request_temperatures_by_address(Dallas *dt,
                                                  const uint8_t *addr) {
   return (NULL == dt) ? false
@@ -121,32 +276,89 @@ int16_t mgos_dallas_get_temp(Dallas *dt, const uint8_t *addr) {
   return (NULL == dt) ? DEVICE_DISCONNECTED_RAW : dt->getTemp((uint8_t *) addr);
 }
 
+int mgos_dallas_read_all(Dallas *dt, int16_t *raw, uint8_t *status, int n) {
+  return (NULL == dt || n <= 0)
+             ? 0
+             : dt->readAll(raw, status, (n > 255) ? 255 : n);
+}
+
+int mgos_dallas_read_all_results(Dallas *dt, int16_t *raw, uint8_t *status,
+                                 int n) {
+  return (NULL == dt || n <= 0)
+             ? 0
+             : dt->readAllResults(raw, status, (n > 255) ? 255 : n);
+}
+
+int mgos_dallas_read_results_by_resolution(Dallas *dt, int res, int16_t *raw,
+                                           uint8_t *status, int n) {
+  return (NULL == dt || n <= 0)
+             ? 0
+             : dt->readResultsByResolution(res, raw, status,
+                                           (n > 255) ? 255 : n);
+}
+
 int mgos_dallas_get_tempc(Dallas *dt, const uint8_t *addr) {
   return (NULL == dt) ? DEVICE_DISCONNECTED_C
-                      : round(dt->getTempC((uint8_t *) addr) *
-                              100.0);  //(int) (0.5 + dt->getTempC((uint8_t* )
-                                       //addr)*  100.0);
+                      : Dallas::rawToCentiCelsius(dt->getTemp(addr));
 }
 
 int mgos_dallas_get_tempf(Dallas *dt, const uint8_t *addr) {
   return (NULL == dt) ? DEVICE_DISCONNECTED_F
-                      : round(dt->getTempF((uint8_t *) addr) *
-                              100.0);  //(int) (0.5 + dt->getTempF((uint8_t* )
-                                       //addr)*  100.0);
+                      : Dallas::rawToCentiFahrenheit(dt->getTemp(addr));
+}
+
+/*
+ * an index out of range reads as a disconnected device
+ */
+static int16_t getTempByIndex(Dallas *dt, int idx) {
+  uint8_t addr[8];
+  if (idx < 0 || idx > 255 || !dt->getAddress(addr, idx)) {
+    return DEVICE_DISCONNECTED_RAW;
+  }
+  return dt->getTemp(addr);
 }
 
 int mgos_dallas_get_tempc_by_index(Dallas *dt, int idx) {
-  return (NULL == dt)
-             ? DEVICE_DISCONNECTED_C
-             : round(dt->getTempCByIndex(idx) *
-                     100.0);  //(int) (0.5 + dt->getTempCByIndex(idx)*  100.0);
+  return (NULL == dt) ? DEVICE_DISCONNECTED_C
+                      : Dallas::rawToCentiCelsius(getTempByIndex(dt, idx));
 }
 
 int mgos_dallas_get_tempf_by_index(Dallas *dt, int idx) {
-  return (NULL == dt)
-             ? DEVICE_DISCONNECTED_F
-             : round(dt->getTempFByIndex(idx) *
-                     100.0);  //(int) (0.5 + dt->getTempFByIndex(idx)*  100.0);
+  return (NULL == dt) ? DEVICE_DISCONNECTED_F
+                      : Dallas::rawToCentiFahrenheit(getTempByIndex(dt, idx));
+}
+
+int mgos_dallas_raw_to_centi_c(int16_t raw) {
+  return Dallas::rawToCentiCelsius(raw);
+}
+
+int mgos_dallas_raw_to_centi_f(int16_t raw) {
+  return Dallas::rawToCentiFahrenheit(raw);
+}
+
+int mgos_dallas_raw_to_milli_c(int16_t raw) {
+  return Dallas::rawToMilliCelsius(raw);
+}
+
+void mgos_dallas_raw_to_centi_c_array(const int16_t *raw, int32_t *out,
+                                      int n) {
+  if (raw != NULL && out != NULL && n > 0) {
+    Dallas::rawToCentiCelsius(raw, out, (n > 255) ? 255 : n);
+  }
+}
+
+void mgos_dallas_raw_to_centi_f_array(const int16_t *raw, int32_t *out,
+                                      int n) {
+  if (raw != NULL && out != NULL && n > 0) {
+    Dallas::rawToCentiFahrenheit(raw, out, (n > 255) ? 255 : n);
+  }
+}
+
+void mgos_dallas_raw_to_milli_c_array(const int16_t *raw, int32_t *out,
+                                      int n) {
+  if (raw != NULL && out != NULL && n > 0) {
+    Dallas::rawToMilliCelsius(raw, out, (n > 255) ? 255 : n);
+  }
 }
 
 bool mgos_dallas_is_parasite_power_mode(Dallas *dt) {
@@ -160,3 +372,164 @@ bool mgos_dallas_is_conversion_complete(Dallas *dt) {
 int16_t mgos_dallas_millis_to_wait_for_conversion(Dallas *dt, int res) {
   return (NULL == dt) ? 0 : dt->millisToWaitForConversion(res);
 }
+
+bool mgos_dallas_get_bus_stats(Dallas *dt, int op, DallasBusStats *stats) {
+  return (NULL == dt || NULL == stats || op < 0)
+             ? false
+             : dt->getBusStats(op, stats);
+}
+
+void mgos_dallas_reset_bus_stats(Dallas *dt) {
+  if (NULL != dt) {
+    dt->resetBusStats();
+  }
+}
+
+DallasBusGroup *mgos_dallas_bus_group_create(void) {
+  return new DallasBusGroup();
+}
+
+void mgos_dallas_bus_group_close(DallasBusGroup *grp) {
+  if (grp != NULL) {
+    delete grp;
+  }
+}
+
+bool mgos_dallas_bus_group_add_bus(DallasBusGroup *grp, Dallas *dt) {
+  return (NULL == grp) ? false : grp->addBus(dt);
+}
+
+int mgos_dallas_bus_group_get_device_count(DallasBusGroup *grp) {
+  return (NULL == grp) ? 0 : grp->getDeviceCount();
+}
+
+int mgos_dallas_bus_group_read_all(DallasBusGroup *grp, int16_t *raw,
+                                   uint8_t *status, int n) {
+  return (NULL == grp || n <= 0) ? 0
+                                 : grp->readAll(raw, status,
+                                                (n > 65535) ? 65535 : n);
+}
+
+DallasSampleStore *mgos_dallas_sample_store_create(void) {
+  return new DallasSampleStore();
+}
+
+void mgos_dallas_sample_store_close(DallasSampleStore *st) {
+  if (st != NULL) {
+    delete st;
+  }
+}
+
+void mgos_dallas_set_sample_store(Dallas *dt, DallasSampleStore *st) {
+  if (NULL != dt) {
+    dt->setSampleStore(st);
+  }
+}
+
+void mgos_dallas_set_change_reporting(Dallas *dt, int deadband,
+                                      int max_silence_ms,
+                                      mgos_dallas_change_cb_t cb, void *arg) {
+  if (NULL != dt && deadband >= 0 && max_silence_ms >= 0) {
+    dt->setChangeReporting((deadband > 65535) ? 65535 : deadband,
+                           max_silence_ms, cb, arg);
+  }
+}
+
+bool mgos_dallas_sample_store_set_window(DallasSampleStore *st, int index,
+                                         int millis) {
+  return (NULL == st || index < 0 || index > 255 || millis < 0)
+             ? false
+             : st->setWindow(index, millis);
+}
+
+int mgos_dallas_sample_store_get_samples(DallasSampleStore *st,
+                                         const uint8_t *addr, uint32_t *times,
+                                         int16_t *raw, int n) {
+  if (NULL == st || NULL == addr || NULL == raw || n <= 0) {
+    return 0;
+  }
+  DallasSampleStore::Sample samples[DALLAS_SAMPLE_DEPTH];
+  uint8_t count = st->getSamples(
+      addr, samples, (n > DALLAS_SAMPLE_DEPTH) ? DALLAS_SAMPLE_DEPTH : n);
+  for (uint8_t i = 0; i < count; i++) {
+    if (NULL != times) {
+      times[i] = samples[i].time;
+    }
+    raw[i] = samples[i].raw;
+  }
+  return count;
+}
+
+bool mgos_dallas_sample_store_get_rollup(DallasSampleStore *st,
+                                         const uint8_t *addr, int index,
+                                         bool current, int16_t *min,
+                                         int16_t *max, int16_t *mean,
+                                         int *count) {
+  DallasSampleStore::Rollup rollup;
+  if (NULL == st || NULL == addr || index < 0 || index > 255 ||
+      !st->getRollup(addr, index, current, &rollup)) {
+    return false;
+  }
+  if (NULL != min) {
+    *min = rollup.min;
+  }
+  if (NULL != max) {
+    *max = rollup.max;
+  }
+  if (NULL != mean) {
+    *mean = rollup.mean;
+  }
+  if (NULL != count) {
+    *count = rollup.count;
+  }
+  return true;
+}
+
+#if DALLAS_BUS_WORKER
+DallasBusWorker *mgos_dallas_worker_create(Dallas *dt, int stack_size,
+                                           int priority) {
+  if (NULL == dt || stack_size <= 0 || priority < 0) {
+    return NULL;
+  }
+  DallasBusWorker *wk = new DallasBusWorker(dt);
+  if (!wk->begin(stack_size, priority)) {
+    delete wk;
+    return NULL;
+  }
+  return wk;
+}
+
+void mgos_dallas_worker_close(DallasBusWorker *wk) {
+  if (wk != NULL) {
+    delete wk;
+  }
+}
+
+bool mgos_dallas_worker_convert(DallasBusWorker *wk, mgos_dallas_worker_cb_t cb,
+                                void *arg) {
+  return (NULL == wk) ? false : wk->convert(cb, arg);
+}
+
+bool mgos_dallas_worker_read(DallasBusWorker *wk, const uint8_t *addr,
+                             mgos_dallas_worker_cb_t cb, void *arg) {
+  return (NULL == wk || NULL == addr) ? false : wk->read(addr, cb, arg);
+}
+
+bool mgos_dallas_worker_read_all(DallasBusWorker *wk, int16_t *raw,
+                                 uint8_t *status, int n,
+                                 mgos_dallas_worker_cb_t cb, void *arg) {
+  return (NULL == wk || n <= 0)
+             ? false
+             : wk->readAll(raw, status, (n > 255) ? 255 : n, cb, arg);
+}
+
+bool mgos_dallas_worker_rescan(DallasBusWorker *wk, mgos_dallas_worker_cb_t cb,
+                               void *arg) {
+  return (NULL == wk) ? false : wk->rescan(cb, arg);
+}
+
+bool mgos_dallas_worker_set_resolution(DallasBusWorker *wk, int res,
+                                       mgos_dallas_worker_cb_t cb, void *arg) {
+  return (NULL == wk) ? false : wk->setResolution(res, cb, arg);
+}
+#endif